@@ -0,0 +1,90 @@
+#ifndef _BENCH_H_
+#define _BENCH_H_
+
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <string>
+#include <exception>
+
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+
+#include "assembler.h"
+
+// Helpers shared by the benchmarks, header only so every benchmark still
+// builds from its own source file and the library sources.
+
+using Clock = std::chrono::steady_clock;
+
+inline double elapsed(Clock::time_point start) {
+	return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+inline void writeFile(const std::string& file, const std::string& contents) {
+	std::ofstream output(file, std::ofstream::out | std::ofstream::trunc | std::ofstream::binary);
+	output.write(contents.data(), contents.size());
+}
+
+inline std::string readFile(const std::string& file) {
+	std::ifstream input(file, std::ifstream::in | std::ifstream::binary);
+	return std::string(std::istreambuf_iterator<char>(input), std::istreambuf_iterator<char>());
+}
+
+// options of a benchmark run, the listing would only measure the disk
+inline Assembler::Options benchOptions() {
+	Assembler::Options options;
+	options.listing = false;
+
+	return options;
+}
+
+// time to assemble the source, negative on failure
+inline double assemble(const std::string& source, const std::string& object,
+					   const Assembler::Options& options = benchOptions()) {
+	Clock::time_point start = Clock::now();
+
+	try {
+		Assembler assembler(options);
+		std::string output = object;
+
+		assembler.assemble(source, output);
+	}
+	catch (const std::exception& e) {
+		std::cerr << e.what() << "\n";
+		return -1;
+	}
+
+	return elapsed(start);
+}
+
+struct Run {
+	double time;
+
+	// peak resident set of the child, in KiB
+	long peak;
+};
+
+// assembles in a child process so the peak memory of each run can be told
+// apart, time is negative on failure
+inline Run assembleChild(const std::string& source, const std::string& object,
+						 const Assembler::Options& options = benchOptions()) {
+	Clock::time_point start = Clock::now();
+
+	pid_t child = fork();
+
+	if (child == 0)
+		_exit(assemble(source, object, options) < 0 ? 1 : 0);
+
+	int status = 0;
+	struct rusage usage;
+
+	if (child < 0 || wait4(child, &status, 0, &usage) != child || !WIFEXITED(status) || WEXITSTATUS(status) != 0)
+		return { -1, 0 };
+
+	return { elapsed(start), usage.ru_maxrss };
+}
+
+#endif
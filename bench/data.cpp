@@ -0,0 +1,88 @@
+// Benchmark for large data directives.
+//
+// Assembles generated lookup tables with a thousand literal values per
+// .word/.byte line (plus a few symbolic entries, which take the general
+// path) and checks the section contents against the generated values.
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <cstdio>
+
+#include "object.h"
+#include "bench.h"
+
+using namespace std;
+
+static const size_t VALUES_PER_LINE = 1000;
+
+int main(int argc, char* argv[]) {
+	const size_t lines = argc > 1 ? stoul(argv[1]) : 200;
+
+	const string source = "bench_data.s";
+	const string object = "bench_data.o";
+
+	string text = ".section tables, \"a\"\ntable:\n";
+	vector<uint8_t> expected;
+
+	uint32_t seed = 7;
+
+	for (size_t i = 0; i < lines; i++) {
+		bool words = i % 2 == 0;
+
+		text += words ? "\t.word " : "\t.byte ";
+
+		for (size_t j = 0; j < VALUES_PER_LINE; j++) {
+			seed = seed * 1103515245 + 12345;
+			uint16_t value = words ? seed >> 16 : seed >> 24;
+
+			if (j > 0) text += ", ";
+
+			// every hundredth entry refers to the table itself (offset 0)
+			if (j % 100 == 99) {
+				text += words ? "table" : "0";
+				value = 0;
+			}
+			else if (j % 2)
+				text += to_string(value);
+			else {
+				char hex[8];
+				snprintf(hex, sizeof(hex), "0x%X", value);
+				text += hex;
+			}
+
+			expected.push_back(value & 0xFF);
+			if (words) expected.push_back(value >> 8);
+		}
+
+		text += '\n';
+	}
+
+	text += ".end\n";
+
+	writeFile(source, text);
+
+	double time = assemble(source, object);
+	bool correct = time >= 0;
+
+	if (correct) {
+		MappedObjectFile file(object);
+		file.validate();
+
+		const SectionEntry& section = file.section(0);
+
+		vector<uint8_t> contents(file.contentSize(section));
+		file.extract(section, contents.data());
+
+		correct = contents == expected;
+	}
+
+	cout << "values:          " << lines * VALUES_PER_LINE << " (" << lines << " lines)\n"
+		 << "time:            " << time << " ms (" << time * 1e6 / (lines * VALUES_PER_LINE) << " ns/value)\n"
+		 << "contents:        " << (correct ? "identical" : "MISMATCH") << "\n";
+
+	remove(source.c_str());
+	remove(object.c_str());
+
+	return correct ? 0 : 1;
+}
\ No newline at end of file
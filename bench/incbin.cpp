@@ -0,0 +1,79 @@
+// Benchmark for embedding binary files.
+//
+// Assembles a one megabyte asset once through .incbin and once written out
+// as .byte lines (what had to be done without the directive), and checks
+// that both objects hold the file unchanged.
+
+#include <iostream>
+#include <string>
+#include <cstdio>
+#include <cstring>
+
+#include "object.h"
+#include "bench.h"
+
+using namespace std;
+
+static bool check(const string& object, const string& asset) {
+	MappedObjectFile file(object);
+	file.validate();
+
+	for (const SectionEntry& section : file.sections()) {
+		if (strcmp(file.getString(section.name), "assets")) continue;
+
+		return file.contentSize(section) == asset.size() &&
+			   !memcmp(file.contents(section), asset.data(), asset.size());
+	}
+
+	return false;
+}
+
+int main(int argc, char* argv[]) {
+	const size_t assetSize = argc > 1 ? stoul(argv[1]) : 1 << 20;
+
+	const string asset  = "bench_incbin.bin";
+	const string source = "bench_incbin.s";
+	const string object = "bench_incbin.o";
+
+	string contents(assetSize, '\0');
+	uint32_t seed = 1;
+
+	for (size_t i = 0; i < assetSize; i++) {
+		seed = seed * 1103515245 + 12345;
+		contents[i] = (char)(seed >> 16);
+	}
+
+	writeFile(asset, contents);
+
+	writeFile(source, ".section assets, \"a\"\n\t.incbin \"" + asset + "\"\n.end\n");
+
+	double incbinTime = assemble(source, object);
+	bool correct = incbinTime >= 0 && check(object, contents);
+
+	// the same asset as .byte lines, 16 values each
+	string bytes = ".section assets, \"a\"\n";
+
+	for (size_t i = 0; i < assetSize; i++) {
+		bytes += i % 16 == 0 ? "\t.byte " : ", ";
+		bytes += to_string((uint8_t)contents[i]);
+
+		if (i % 16 == 15 || i + 1 == assetSize) bytes += '\n';
+	}
+
+	bytes += ".end\n";
+	writeFile(source, bytes);
+
+	double byteTime = assemble(source, object);
+	correct = correct && byteTime >= 0 && check(object, contents);
+
+	cout << "asset size:      " << assetSize / 1024 << " KB\n"
+		 << ".incbin:         " << incbinTime << " ms\n"
+		 << ".byte lines:     " << byteTime << " ms\n"
+		 << "contents:        " << (correct ? "identical" : "MISMATCH") << "\n";
+
+	remove(asset.c_str());
+	remove(source.c_str());
+	remove(object.c_str());
+
+	return correct ? 0 : 1;
+}
\ No newline at end of file
@@ -0,0 +1,82 @@
+// Benchmark for the cache of included files.
+//
+// Assembles many small translation units in one process, all including the
+// same large header of constants and declarations. The header is tokenized
+// by the first assembly only; the others reuse it, unless the header
+// changes in between, which is checked to be picked up.
+
+#include <iostream>
+#include <string>
+#include <cstdio>
+
+#include <utime.h>
+
+#include "object.h"
+#include "bench.h"
+
+using namespace std;
+
+static string header(size_t constants, int base) {
+	string source = ".section constants, \"a\"\n";
+
+	for (size_t i = 0; i < constants; i++)
+		source += ".equ CONSTANT_" + to_string(i) + ", " + to_string(base * 1000 + i % 1000) + "\t# shared constant\n";
+
+	for (size_t i = 0; i < constants / 4; i++)
+		source += ".extern routine_" + to_string(i) + "\n";
+
+	return source;
+}
+
+// value of CONSTANT_0 in the object
+static int32_t constant(const string& object) {
+	MappedObjectFile file(object);
+	file.validate();
+
+	uint32_t index = file.findSymbol("CONSTANT_0");
+
+	return index == NO_INDEX ? -1 : littleEndian(file.symbol(index).value);
+}
+
+int main(int argc, char* argv[]) {
+	const size_t units     = argc > 1 ? stoul(argv[1]) : 200;
+	const size_t constants = 20000;
+
+	const string include = "bench_include.inc";
+	const string source  = "bench_include.s";
+	const string object  = "bench_include.o";
+
+	writeFile(include, header(constants, 1));
+	writeFile(source, ".include \"" + include + "\"\n.text\n\tmov r0, CONSTANT_0\n\thalt\n.end\n");
+
+	double first = assemble(source, object);
+	bool correct = first >= 0 && constant(object) == 1000;
+
+	double rest = 0;
+
+	for (size_t i = 1; correct && i < units; i++) {
+		double time = assemble(source, object);
+
+		correct = time >= 0;
+		rest += time;
+	}
+
+	// a changed header (same size, new modification time) is read again
+	writeFile(include, header(constants, 2));
+
+	struct utimbuf times = { 0, 1 };
+	utime(include.c_str(), &times);
+
+	correct = correct && assemble(source, object) >= 0 && constant(object) == 2000;
+
+	cout << "header:          " << constants << " constants\n"
+		 << "first unit:      " << first << " ms\n"
+		 << "other units:     " << rest / (units - 1) << " ms (mean of " << units - 1 << ")\n"
+		 << "results:         " << (correct ? "correct" : "MISMATCH") << "\n";
+
+	remove(include.c_str());
+	remove(source.c_str());
+	remove(object.c_str());
+
+	return correct ? 0 : 1;
+}
\ No newline at end of file
@@ -0,0 +1,108 @@
+// Scaling benchmark for symbol and section counts.
+//
+// Generates sources with a label per basic block (and a section every few
+// labels), assembles them with doubling sizes up to one million labels and
+// checks that the time per label stays flat. Symbol and section counts go
+// well past the 65535 a 16-bit index could hold, so the resulting object is
+// also checked for the right entry of every label.
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <cstdio>
+
+#include "object.h"
+#include "bench.h"
+
+using namespace std;
+
+static const size_t LABELS_PER_SECTION = 8;
+
+static void generate(const string& file, size_t labels) {
+	string source;
+	source.reserve(labels * 40);
+
+	for (size_t i = 0; i < labels; i++) {
+		if (i % LABELS_PER_SECTION == 0) {
+			source += ".section block";
+			source += to_string(i / LABELS_PER_SECTION);
+			source += ", \"ax\"\n";
+		}
+
+		source += "L";
+		source += to_string(i);
+		source += ":\tadd r0, 1\n";
+
+		// a branch back to the first block of the section
+		if (i % LABELS_PER_SECTION == LABELS_PER_SECTION - 1) {
+			source += "\tjne $L";
+			source += to_string(i - LABELS_PER_SECTION + 1);
+			source += '\n';
+		}
+	}
+
+	writeFile(file, source);
+}
+
+static bool check(const string& file, size_t labels) {
+	MappedObjectFile object(file);
+	object.validate();
+
+	const size_t sections = (labels + LABELS_PER_SECTION - 1) / LABELS_PER_SECTION;
+
+	if (object.count(SECTIONS) != sections || object.count(SYMBOLS) != labels + sections)
+		return false;
+
+	// entries follow the source: section symbol, then its labels
+	for (size_t i = 0, entry = 0; i < labels; i++) {
+		if (i % LABELS_PER_SECTION == 0) ++entry;
+
+		const SymbolEntry& symbol = object.symbol(entry++);
+
+		if (object.getString(symbol.name) != "L" + to_string(i) ||
+			littleEndian(symbol.section) != i / LABELS_PER_SECTION ||
+			littleEndian(symbol.value) != (int32_t)(i % LABELS_PER_SECTION * 5))
+			return false;
+	}
+
+	return true;
+}
+
+int main(int argc, char* argv[]) {
+	const size_t maxLabels = argc > 1 ? stoul(argv[1]) : 1000000;
+
+	const string source = "bench_labels.s";
+	const string object = "bench_labels.o";
+
+	vector<double> perLabel;
+	bool correct = true;
+
+	for (size_t labels = maxLabels / 4; labels <= maxLabels && correct; labels *= 2) {
+		generate(source, labels);
+
+		double time = assemble(source, object);
+
+		if (time < 0) {
+			correct = false;
+			break;
+		}
+
+		perLabel.push_back(time * 1e6 / labels);
+
+		correct = check(object, labels);
+
+		cout << "labels: " << labels << ", sections: " << (labels + LABELS_PER_SECTION - 1) / LABELS_PER_SECTION
+			 << ", time: " << time << " ms (" << perLabel.back() << " ns/label)"
+			 << (correct ? "" : " MISMATCH") << "\n";
+	}
+
+	remove(source.c_str());
+	remove(object.c_str());
+
+	// linear within a generous margin for timer and allocator noise
+	bool linear = correct && perLabel.back() < perLabel.front() * 2;
+
+	cout << "scaling:         " << (linear ? "linear" : "NOT LINEAR") << "\n";
+
+	return linear ? 0 : 1;
+}
\ No newline at end of file
@@ -0,0 +1,70 @@
+// Benchmark for lexing the main file on several threads.
+//
+// Assembles one large generated source with 1 to 16 lexing threads. The
+// source is split into pieces tokenized in parallel while the first pass
+// walks those already done; every object is checked to be identical to
+// the one assembled on a single thread.
+
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <cstdio>
+
+#include "bench.h"
+
+using namespace std;
+
+int main(int argc, char* argv[]) {
+	const size_t blocks = argc > 1 ? stoul(argv[1]) : 20000;
+
+	const string source = "bench_lex.s";
+	const string object = "bench_lex.o";
+
+	{
+		ofstream output(source, ofstream::out | ofstream::trunc);
+
+		output << ".global start\n.extern table\n\n.text\nstart:\tjmp block0\n";
+
+		// long comments and spacing make lexing a good share of the work
+		for (size_t i = 0; i < blocks; i++) {
+			if (i % 1000 == 0) output << ".section code" << i / 1000 << ", \"ax\"\n";
+
+			output << "block" << i << ":\tmov   r0,   r1\t\t# copy the argument into the accumulator\n"
+				   << "\tadd   r0,   3\t\t\t# step\n"
+				   << "\n"
+				   << "\tmov   r2,   table\t\t# compare with the table\n"
+				   << "\tcmp   r0,   r2\n"
+				   << "\tjne   block" << i << "\n"
+				   << ".word block" << i << ",   " << i % 1000 << ",   7\n";
+		}
+
+		output << "\thalt\n.end\n";
+	}
+
+	Assembler::Options options = benchOptions();
+
+	double single = assemble(source, object, options);
+	string expected = readFile(object);
+
+	bool identical = single >= 0 && !expected.empty();
+
+	cout << "source:          " << readFile(source).size() / 1024 << " KiB, " << blocks * 7 << " lines\n"
+		 << "1 thread:        " << single << " ms\n";
+
+	for (uint32_t threads = 2; identical && threads <= 16; threads *= 2) {
+		options.threads = threads;
+
+		double time = assemble(source, object, options);
+
+		identical = time >= 0 && readFile(object) == expected;
+
+		cout << threads << " threads:" << string(threads < 10 ? 7 : 6, ' ') << time << " ms, x" << single / time << "\n";
+	}
+
+	cout << "objects:         " << (identical ? "identical" : "MISMATCH") << "\n";
+
+	remove(source.c_str());
+	remove(object.c_str());
+
+	return identical ? 0 : 1;
+}
\ No newline at end of file
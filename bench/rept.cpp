@@ -0,0 +1,84 @@
+// Benchmark for .rept and macro expansion.
+//
+// Assembles an unrolled loop once as a .rept block invoking a macro and
+// once written out line by line, and checks that both objects are
+// identical. The expansion is walked lazily and its instructions are
+// decoded again by the second pass instead of being kept, so the memory of
+// the .rept source grows only with the code and line table it produces.
+// That is checked against a .rept of a single iteration.
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <cstdio>
+
+#include "object.h"
+#include "bench.h"
+
+using namespace std;
+
+// contents of the first section, the line tables of the two objects differ
+static vector<uint8_t> code(const string& file) {
+	MappedObjectFile object(file);
+	object.validate();
+
+	if (object.count(SECTIONS) == 0) return {};
+
+	vector<uint8_t> contents(object.contentSize(object.section(0)));
+	object.extract(object.section(0), contents.data());
+
+	return contents;
+}
+
+// bytes of peak memory per instruction the expansion may add, for its
+// code and line table entry with room for vector growth
+static const long BYTES_PER_INSTRUCTION = 64;
+
+static string rept(size_t iterations) {
+	const string body = "\tadd \\accumulator, r1\n\tshl r1, 1\n\txor \\accumulator, r1\n";
+
+	return ".macro step accumulator\n" + body + ".endm\n.text\n.rept " + to_string(iterations) +
+		   "\n\tstep r0\n.endr\n\thalt\n.end\n";
+}
+
+int main(int argc, char* argv[]) {
+	const size_t iterations = argc > 1 ? stoul(argv[1]) : 300000;
+
+	const string source = "bench_rept.s";
+	const string object = "bench_rept.o";
+
+	writeFile(source, rept(1));
+	Run single = assembleChild(source, object);
+
+	writeFile(source, rept(iterations));
+	Run repeated = assembleChild(source, object);
+
+	vector<uint8_t> reptCode = repeated.time >= 0 ? code(object) : vector<uint8_t>();
+
+	string unrolled = ".text\n";
+
+	for (size_t i = 0; i < iterations; i++)
+		unrolled += "\tadd r0, r1\n\tshl r1, 1\n\txor r0, r1\n";
+
+	unrolled += "\thalt\n.end\n";
+	writeFile(source, unrolled);
+
+	Run written = assembleChild(source, object);
+
+	bool identical = repeated.time >= 0 && written.time >= 0 && !reptCode.empty() && reptCode == code(object);
+
+	long growth = single.time >= 0 ? (repeated.peak - single.peak) * 1024 / (long)(iterations * 3) : -1;
+	bool bounded = growth >= 0 && growth <= BYTES_PER_INSTRUCTION;
+
+	cout << "iterations:      " << iterations << " (" << iterations * 3 << " instructions)\n"
+		 << ".rept:           " << repeated.time << " ms, peak " << repeated.peak << " KiB\n"
+		 << "unrolled source: " << written.time << " ms, peak " << written.peak << " KiB\n"
+		 << "one iteration:   peak " << single.peak << " KiB, " << growth << " bytes/instruction more\n"
+		 << "code:            " << (identical ? "identical" : "MISMATCH") << "\n"
+		 << "memory:          " << (bounded ? "bounded" : "NOT BOUNDED") << "\n";
+
+	remove(source.c_str());
+	remove(object.c_str());
+
+	return identical && bounded ? 0 : 1;
+}
@@ -0,0 +1,204 @@
+// Round-trip benchmark for object file serialization.
+//
+// Builds a multi-megabyte object in memory (symbols, data sections and
+// relocations), writes it the same way Assembler::writeELF does, maps the
+// image back into memory, validates it and checks every table against
+// the source data, then resolves names through the symbol hash index.
+// The same object is written once more with compressed data sections
+// and decompressed again.
+
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <cstdio>
+#include <cstring>
+#include <utility>
+#include <algorithm>
+#include <unordered_map>
+
+#include "types.h"
+#include "symbol.h"
+#include "section.h"
+#include "relocation.h"
+#include "object.h"
+#include "bench.h"
+
+using namespace std;
+
+static uint8_t pattern(size_t section, size_t position) {
+	return (uint8_t)(section * 31 + position);
+}
+
+int main(int argc, char* argv[]) {
+	const size_t sectionCount    = 64;
+	const size_t sectionSize     = 0xFFF0;
+	const size_t symbolCount     = 50000;
+	const size_t relocationCount = 100000;
+
+	const string file = argc > 1 ? argv[1] : "bench_serialization.o";
+
+	unordered_map<string, Symbol*>  symbolTable;
+	unordered_map<string, Section*> sectionTable;
+	vector<Relocation*> relocations;
+
+	for (size_t i = 0; i < sectionCount; i++) {
+		string name = "data" + to_string(i);
+
+		uint32_t entry = symbolTable.size();
+
+		Section* section = new Section(name, i, entry, "1100000000");
+
+		vector<uint8_t> bytes(sectionSize);
+		for (size_t j = 0; j < sectionSize; j++) bytes[j] = pattern(i, j);
+
+		section->write(0, bytes);
+
+		symbolTable[name]  = new Symbol(name, entry, name, 0, LOCAL, SymbolType::SECTION, true);
+		sectionTable[name] = section;
+	}
+
+	for (size_t i = 0; i < symbolCount; i++) {
+		string name = "label_" + to_string(i);
+		symbolTable[name] = new Symbol(name, sectionCount + i, "data" + to_string(i % sectionCount), i & 0x7FFF, GLOBAL, SymbolType::LABEL, true);
+	}
+
+	for (size_t i = 0; i < relocationCount; i++) {
+		relocations.push_back(new Relocation("label_" + to_string(i % symbolCount),
+											 "data" + to_string(i % sectionCount),
+											 i & 0x7FFF, R_386_16));
+	}
+
+	// serialization
+	Clock::time_point start = Clock::now();
+
+	string buffer;
+
+	ObjectWriter writer(symbolTable, sectionTable, relocations);
+	writer.setHashIndex(true);
+	writer.write(buffer);
+
+	{
+		ofstream output(file, ofstream::out | ofstream::trunc | ofstream::binary);
+		output.write(buffer.data(), buffer.size());
+	}
+
+	double writeTime = elapsed(start);
+
+	// deserialization, the image is mapped and validated in place
+	start = Clock::now();
+
+	MappedObjectFile object(file);
+	object.validate();
+
+	double readTime = elapsed(start);
+
+	// verification
+	bool identical = object.count(SYMBOLS) == symbolTable.size() &&
+					 object.count(SECTIONS) == sectionTable.size();
+
+	for (uint32_t i = 0; identical && i < object.count(SECTIONS); i++) {
+		const SectionEntry& entry = object.section(i);
+		const uint8_t* contents = object.contents(entry);
+
+		identical = object.getString(entry.name) == "data" + to_string(i) &&
+					littleEndian(entry.stored) == sectionSize;
+
+		for (size_t j = 0; identical && j < sectionSize; j++)
+			identical = contents[j] == pattern(i, j);
+	}
+
+	// relocations come back grouped by section and sorted by offset
+	for (uint32_t i = 0; identical && i < object.count(SECTIONS); i++) {
+		vector<pair<uint32_t, size_t>> expected;
+
+		for (size_t j = i; j < relocationCount; j += sectionCount)
+			expected.push_back({ j & 0x7FFF, j % symbolCount });
+
+		stable_sort(expected.begin(), expected.end(), [](const pair<uint32_t, size_t>& a, const pair<uint32_t, size_t>& b) {
+			return a.first < b.first;
+		});
+
+		RelocationReader reader = object.relocations(object.section(i));
+		RelocationEntry entry;
+
+		for (size_t j = 0; identical && j < expected.size(); j++) {
+			identical = reader.next(entry) &&
+						entry.offset == expected[j].first &&
+						object.getString(object.symbol(entry.symbol).name) == "label_" + to_string(expected[j].second);
+		}
+
+		identical = identical && !reader.next(entry);
+	}
+
+	// lookup of every exported name and as many missing ones through the hash index
+	start = Clock::now();
+
+	for (size_t i = 0; identical && i < symbolCount; i++) {
+		string name = "label_" + to_string(i);
+		uint32_t index = object.findSymbol(name.c_str());
+
+		identical = index != NO_INDEX && object.getString(object.symbol(index).name) == name &&
+					object.findSymbol(("missing_" + to_string(i)).c_str()) == NO_INDEX;
+	}
+
+	double lookupTime = elapsed(start);
+
+	// compressed data sections
+	const string compressedFile = file + ".lz";
+
+	start = Clock::now();
+
+	string compressed;
+
+	ObjectWriter compressingWriter(symbolTable, sectionTable, relocations);
+	compressingWriter.setHashIndex(true);
+	compressingWriter.setCompression(true);
+	compressingWriter.write(compressed);
+
+	{
+		ofstream output(compressedFile, ofstream::out | ofstream::trunc | ofstream::binary);
+		output.write(compressed.data(), compressed.size());
+	}
+
+	double compressTime = elapsed(start);
+
+	MappedObjectFile compressedObject(compressedFile);
+	compressedObject.validate();
+
+	start = Clock::now();
+
+	vector<uint8_t> contents(sectionSize);
+
+	for (uint32_t i = 0; identical && i < compressedObject.count(SECTIONS); i++) {
+		const SectionEntry& entry = compressedObject.section(i);
+
+		identical = littleEndian(entry.encoding) == LZ && compressedObject.contentSize(entry) == sectionSize;
+
+		if (identical) compressedObject.extract(entry, contents.data());
+
+		for (size_t j = 0; identical && j < sectionSize; j++)
+			identical = contents[j] == pattern(i, j);
+	}
+
+	double decompressTime = elapsed(start);
+
+	cout << "object size:     " << buffer.size() / 1024 << " KB\n"
+		 << "relocations:     " << object.count(RELOCATIONS) / 1024 << " KB (" << relocationCount << " entries)\n"
+		 << "serialization:   " << writeTime << " ms\n"
+		 << "deserialization: " << readTime << " ms\n"
+		 << "symbol lookups:  " << lookupTime << " ms (" << symbolCount * 2 << " names)\n"
+		 << "compressed size: " << compressed.size() / 1024 << " KB\n"
+		 << "compression:     " << compressTime << " ms\n"
+		 << "decompression:   " << decompressTime << " ms (" << sectionCount * sectionSize / 1024 << " KB)\n"
+		 << "round-trip:      " << (identical ? "identical" : "MISMATCH") << "\n";
+
+	for (auto& entry : symbolTable) delete entry.second;
+	for (auto& entry : sectionTable) delete entry.second;
+	for (auto& relocation : relocations) delete relocation;
+
+	remove(file.c_str());
+	remove(compressedFile.c_str());
+
+	return identical ? 0 : 1;
+}
\ No newline at end of file
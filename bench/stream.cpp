@@ -0,0 +1,66 @@
+// Benchmark for streaming assembly.
+//
+// Assembles a large generated source with and without --stream, each in a
+// child process so their peak memory can be told apart, and checks that
+// both objects are identical. Streaming keeps one chunk of statements, no
+// decoded instructions and hands the finished output to temporary files, so
+// its peak follows the symbols rather than the source or the output.
+
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <cstdio>
+
+#include "bench.h"
+
+using namespace std;
+
+int main(int argc, char* argv[]) {
+	const size_t blocks = argc > 1 ? stoul(argv[1]) : 20000;
+
+	const string source = "bench_stream.s";
+	const string object = "bench_stream.o";
+
+	{
+		ofstream output(source, ofstream::out | ofstream::trunc);
+
+		output << ".global start\n.extern table\n\n.text\n.equ STEP, 3\nstart:\tjmp block0\n";
+
+		// one label per block of straight line code and data, sections stay within 64 KiB
+		for (size_t i = 0; i < blocks; i++) {
+			if (i % 1000 == 0) output << ".section code" << i / 1000 << ", \"ax\"\n";
+
+			output << "block" << i << ":\tmov r0, r1\t\t# copy\n"
+				   << "\tadd r0, STEP\n"
+				   << "\tshl r0, 1\n"
+				   << "\tmov r2, table\n"
+				   << "\tcmp r0, r2\n"
+				   << "\tjne block" << i << "\n"
+				   << ".word block" << i << ", " << i % 1000 << ", STEP * 2\n";
+		}
+
+		output << "\thalt\n.end\n";
+	}
+
+	Assembler::Options options = benchOptions();
+
+	Run normal = assembleChild(source, object, options);
+	string normalObject = readFile(object);
+
+	options.stream = true;
+
+	Run streamed = assembleChild(source, object, options);
+	string streamedObject = readFile(object);
+
+	bool identical = normal.time >= 0 && streamed.time >= 0 && !normalObject.empty() && normalObject == streamedObject;
+
+	cout << "source:          " << readFile(source).size() / 1024 << " KiB, " << blocks * 7 << " lines\n"
+		 << "in memory:       " << normal.time << " ms, peak " << normal.peak << " KiB\n"
+		 << "streamed:        " << streamed.time << " ms, peak " << streamed.peak << " KiB\n"
+		 << "object:          " << (identical ? "identical" : "MISMATCH") << "\n";
+
+	remove(source.c_str());
+	remove(object.c_str());
+
+	return identical ? 0 : 1;
+}
\ No newline at end of file
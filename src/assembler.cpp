@@ -3,14 +3,22 @@
 #include <vector>
 #include <string>
 #include <utility>
+#include <algorithm>
 #include <unordered_map>
 #include <unordered_set>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <sstream>
+#include <iterator>
 #include <iostream>
 #include <exception>
 #include <regex>
 #include <cmath>
 #include <cstdlib>
-#include <iomanip>
+#include <cstdint>
+
+#include <sys/stat.h>
 
 #include "assembler.h"
 #include "exceptions.h"
@@ -20,11 +28,87 @@
 #include "section.h"
 #include "instruction.h"
 #include "relocation.h"
+#include "expression.h"
+#include "object.h"
+#include "image.h"
 
 using namespace std;
 
 
+// nesting of .include, also stops inclusion cycles through symbolic links
+static const size_t MAX_INCLUDE_DEPTH = 64;
+
+// statements of the main file tokenized at a time by the reader thread
+static const size_t CHUNK_STATEMENTS = 4096;
+
+// contents and relocations a streamed section holds before they are handed over
+static const size_t SPILL_BYTES = 64 * 1024;
+static const size_t SPILL_RELOCATIONS = 4096;
+
+// smallest piece of the main file lexed on a thread of its own
+static const size_t MIN_PIECE = 64 * 1024;
+
+
+// path with "." and "dir/.." components and repeated separators folded away,
+// so one file spelled differently is still found in the include stack and cache
+static string normalizePath(const string& path) {
+	vector<string> parts;
+	size_t start = 0;
+
+	while (start <= path.size()) {
+		size_t end = path.find('/', start);
+		if (end == string::npos) end = path.size();
+
+		string part = path.substr(start, end - start);
+		start = end + 1;
+
+		if (part.empty() || part == ".") continue;
+
+		if (part == ".." && !parts.empty() && parts.back() != "..")
+			parts.pop_back();
+		else if (part != ".." || path[0] != '/')
+			parts.push_back(part);
+	}
+
+	string result = path[0] == '/' ? "/" : "";
+
+	for (size_t i = 0; i < parts.size(); i++)
+		result += (i ? "/" : "") + parts[i];
+
+	return result.empty() ? "." : result;
+}
+
+
+// hash of the contents of a file, of no contents if it can't be read
+static uint64_t hashFile(const string& path) {
+	ifstream input(path, ifstream::in | ifstream::binary);
+
+	uint64_t hash = Utils::hash64(nullptr, 0);
+	char buffer[64 * 1024];
+
+	while (input.read(buffer, sizeof(buffer)) || input.gcount() > 0)
+		hash = Utils::hash64((const uint8_t*)buffer, input.gcount(), hash);
+
+	return hash;
+}
+
+
+unordered_map<string, Assembler::CachedFile> Assembler::includeCache;
+mutex Assembler::includeMutex;
+
+
 Assembler::~Assembler() {
+	{
+		lock_guard<mutex> lock(chunkMutex);
+		stopReader = true;
+	}
+
+	chunkChanged.notify_all();
+	if (reader.joinable()) reader.join();
+
+	Chunk* chunk;
+	while (chunks.pop(chunk)) delete chunk;
+
 	for (auto& entry : symbolTable)  delete entry.second;
 
 	for (auto& entry : sectionTable) delete entry.second;
@@ -32,21 +116,69 @@ Assembler::~Assembler() {
 	for (auto& entry : UST) delete entry.second;
 
 	for (auto& relocation : relocationTable) delete relocation;
+
+	for (auto& block : blocks) delete block;
+
+	// left over when an error stops assembling before the second pass
+	for (; !instructions.empty(); instructions.pop()) delete instructions.front();
+
+	delete entity;
 }
 
 
 void Assembler::assemble(const string& input, string& output) {
+	if (options.ifChanged && !options.check && upToDate(input, output)) {
+		cout << "Assembling skipped, output is up to date!\n\n";
+		return;
+	}
+
 	readAssembly(input);
 
-	firstPass();
+	try {
+		firstPass();
+
+		resolveSymbols();
+
+		// a streamed object takes over the sections as the second pass finishes them
+		if (options.stream && options.format == OBJECT && !options.check) {
+			objectWriter = createWriter(output);
+
+			if (options.listing) {
+				relocationRows.reset(new SpillFile());
+				lineRows.reset(new SpillFile());
+			}
+		}
+
+		// the second pass finds value and operand errors, the object and listing are skipped
+		secondPass();
+	}
+	catch (const AssemblingException&) {
+		reportErrors();
+		throw;
+	}
+
+	if (!diagnostics.empty()) {
+		reportErrors();
+
+		size_t count = diagnostics.size();
+		throw AssemblingException(to_string(count) + (count == 1 ? " error" : " errors") + " found, nothing written!");
+	}
 
-	resolveSymbols();
+	if (options.check) {
+		cout << "Check finished successfully!\n\n";
+		return;
+	}
 
-	secondPass();
+	if (options.format == OBJECT)
+		writeELF(output);
+	else
+		writeImage(output);
 
-	writeELF(output);
+	if (options.listing)
+		writeText(output.substr(0, output.rfind('.')) + ".txt");
 
-	writeText(output.replace(output.size() - 1, 1, "txt"));
+	if (options.dependencies)
+		writeDependencies(options.dependencyFile.empty() ? output.substr(0, output.rfind('.')) + ".d" : options.dependencyFile, output);
 
 	cout << "Assembling finished successfully!\n\n";
 }
@@ -56,14 +188,28 @@ void Assembler::readAssembly(const string& file) {
 	if (!std::regex_search(file, assemblyFile))
 		throw AssemblingException("Invalid input file type -> assembly file (.s) expected!");
 
-	ifstream input(file, ifstream::in);
+	input.open(file, ifstream::in);
 
 	if (!input.is_open())
 		throw AssemblingException("Can't open file " + file + "!");
 
+	sourceFiles.push_back(file);
+
+	// the first pass walks the chunks as the reader thread tokenizes them
+	if (options.stream) return;
+
+	openBlocks.assign(1, &program);
+	startReader();
+}
+
+
+bool Assembler::tokenize(istream& input, SourceFile& source, uint32_t& number, size_t limit) {
 	string line;
 
-	while (getline(input, line)) {
+	while (source.statements.size() < limit) {
+		if (!getline(input, line)) return true;
+
+		++number;
 		line = line.substr(0, line.find('#'));
 
 		vector<string> tokens;
@@ -71,509 +217,1267 @@ void Assembler::readAssembly(const string& file) {
 
 		if (tokens.size() == 0) continue;
 
-		if (tokens[0] == ".end") break;
+		if (tokens[0] == ".end") return true;
 
-		assembly.push_back(tokens);
+		source.statements.push_back(tokens);
+		source.lines.push_back(number);
 	}
+
+	return false;
 }
 
 
-void Assembler::firstPass() {
-	line = 0;
+void Assembler::rewindInput() {
+	chunkStart = 0;
 
-	bool labelDefined = false;
+	// the second pass walks everything the first one has read
+	if (!options.stream) {
+		if (!inputEnded) readChunk();
+		return;
+	}
 
-	Section* currentSection = nullptr;
+	input.clear();
+	input.seekg(0);
 
-	smatch matches;
-	string currentToken;
-	TokenType currentTokenType;
+	openBlocks.assign(1, &program);
 
-	for (const auto& tokens : assembly) {
-		++line;
+	// macros are defined again as the file is read
+	macros.clear();
 
-		queue<string> queue;
-		for (const auto& token : tokens) queue.push(token);
+	startReader();
+	readChunk();
+}
 
-		currentToken = queue.front();
-		queue.pop();
 
-		currentTokenType = Utils::getTokenType(currentToken, matches);
+bool Assembler::readChunk() {
+	if (inputEnded) return false;
 
-		if (currentTokenType == LABEL) {
-			if (labelDefined)
-				throw AssemblingException(line, "Double label definition!");
+	if (options.stream) {
+		// blocks macros can still expand, with their statements
+		unordered_set<const Block*> reachable;
+		vector<const Block*> pending;
 
-			labelDefined = true;
-			string label = matches[1];
+		for (const auto& entry : macros) pending.push_back(entry.second);
 
-			if (!currentSection)
-				throw AssemblingException(line, "Label \"" + label + "\" defined outside any section!");
+		while (!pending.empty()) {
+			const Block* block = pending.back();
+			pending.pop_back();
 
-			addSymbol(label, currentSection->name, locationCounter, LOCAL, SymbolType::LABEL, true);
+			if (!reachable.insert(block).second) continue;
 
-			if (queue.empty()) continue;
+			for (const auto& item : block->items)
+				if (item.block) pending.push_back(item.block);
+		}
 
-			currentToken = queue.front();
-			queue.pop();
+		vector<vector<string>> statements;
+		vector<uint32_t> numbers;
+		vector<uint32_t> files;
+		vector<Block*> kept;
 
-			currentTokenType = Utils::getTokenType(currentToken, matches);
-		}
+		for (Block* block : blocks) {
+			if (!reachable.count(block)) {
+				delete block;
+				continue;
+			}
 
-		labelDefined = false;
+			for (auto& item : block->items) {
+				if (item.block) continue;
 
-		switch (currentTokenType) {
-		case GLOBAL_EXTERN: {
-			string directive = currentToken;
+				statements.push_back(move(assembly[item.statement]));
+				numbers.push_back(lineNumbers[item.statement]);
+				files.push_back(fileIndices[item.statement]);
 
-			if (queue.empty())
-				throw AssemblingException(line, "Directive \"" + directive + "\" has no arguments!");
+				item.statement = statements.size() - 1;
+			}
 
-			while (!queue.empty()) {
-				currentToken = queue.front();
-				queue.pop();
+			kept.push_back(block);
+		}
 
-				currentTokenType = Utils::getTokenType(currentToken, matches);
+		assembly.swap(statements);
+		lineNumbers.swap(numbers);
+		fileIndices.swap(files);
+		blocks.swap(kept);
 
-				if (currentTokenType != SYMBOL)
-					throw AssemblingException(line, "Directives \".global/.extern\" expect symbol!");
+		program.items.clear();
+	}
 
-				if (symbolTable.count(currentToken) &&
-					symbolTable[currentToken]->defined) {
-					if (directive == ".extern")
-						throw AssemblingException(line, "Symbol \"" + currentToken + "\" defined in file but flaged as extern!");
+	chunkStart = program.items.size();
 
-					symbolTable[currentToken]->scope = GLOBAL;
-				}
-				else {
-					addSymbol(currentToken, UNDEFINED, 0, GLOBAL, SymbolType::EXTERN, false);
-				}
-			}
+	// a chunk ends outside of .macro/.rept blocks and has something to walk
+	while (!inputEnded && (program.items.size() == chunkStart || openBlocks.size() > 1)) {
+		unique_ptr<Chunk> chunk(popChunk());
+		inputEnded = chunk->last;
 
-			break;
-		}
-		case LABEL:
-			throw AssemblingException(line, "Double label definition!");
+		vector<string> includes(1, normalizePath(sourceFiles[0]));
+		addStatements(chunk->source, 0, includes);
+	}
 
-			break;
-		case SECTION: {
-			if (currentSection)
-				currentSection->size = locationCounter;
+	if (inputEnded) {
+		reader.join();
 
-			locationCounter = 0;
+		if (openBlocks.size() > 1)
+			throw AssemblingException("Missing \"" + string(openBlocks.back()->macro ? ".endm" : ".endr") +
+									  "\" for \"" + openBlocks.back()->name + "\"!");
+	}
 
-			bool flagsSet = false;
+	return program.items.size() > chunkStart;
+}
 
-			string flags(10, '0');
-			string name = matches[0];
 
-			if (name == ".section") {
-				if (queue.empty())
-					throw AssemblingException(line, "Section name missing!");
+void Assembler::startReader() {
+	inputEnded = false;
+	stopReader = false;
 
-				currentToken = queue.front();
-				queue.pop();
+	reader = thread(&Assembler::readInput, this);
+}
 
-				currentTokenType = Utils::getTokenType(currentToken, matches);
 
-				if (currentTokenType != SYMBOL && currentTokenType != SECTION && currentTokenType != SECTION_NAME)
-					throw AssemblingException(line, "Illegal section name!");
+void Assembler::readInput() {
+	size_t threads = options.threads ? options.threads : max(1u, thread::hardware_concurrency());
 
-				name = matches[0];
+	if (threads > 1 && !options.stream) {
+		readPieces(threads);
+		return;
+	}
 
-				if (!queue.empty()) {
-					currentToken = queue.front();
-					queue.pop();
+	uint32_t number = 0;
 
-					currentTokenType = Utils::getTokenType(currentToken, matches);
-					if (currentTokenType != SECTION_FLAGS)
-						throw AssemblingException(line, "Illegal section flags!");
+	for (bool last = false; !last;) {
+		Chunk* chunk = new Chunk();
+		last = chunk->last = tokenize(input, chunk->source, number, CHUNK_STATEMENTS);
 
-					Utils::setFlags(flags, matches[0]);
-					flagsSet = true;
-				}
-			}
+		if (!pushChunk(chunk)) return;
+	}
+}
 
-			if (!flagsSet) {
-				if (name == ".text") {
-					flags[A] = flags[X] = '1';
-				}
-				else if (name == ".data") {
-					flags[A] = flags[W] = '1';
-				}
-				else if (name == ".bss") {
-					flags[W] = '1';
-				}
-				else if (name == ".rodata") {
-					flags[A] = '1';
-				}
-				else {
-					flags[A] = flags[W] = flags[X] = '1';
-				}
-			}
 
-			addSymbol(name, name, 0, LOCAL, SymbolType::SECTION, true);
-			uint16_t entry = symbolTable[name]->symbolTableEntry;
+void Assembler::readPieces(size_t threads) {
+	string text((istreambuf_iterator<char>(input)), istreambuf_iterator<char>());
 
-			currentSection = new Section(name, entry, flags);
+	threads = max<size_t>(1, min(threads, text.size() / MIN_PIECE));
 
-			addSection(currentSection);
-			break;
-		}
-		case DIRECTIVE: {
-			if (!currentSection)
-				throw AssemblingException(line, "Directives are only allowed inside a section!");
+	// pieces end right after a newline, only the last one may not
+	vector<size_t> starts(1, 0);
 
-			string directive = matches[0];
+	for (size_t i = 1; i < threads; i++) {
+		size_t newline = text.find('\n', max(starts.back(), text.size() * i / threads));
 
-			if (directive == ".equ") {
-				if (queue.empty())
-					throw AssemblingException(line, "Directive \".equ\" expects symbol and expression!");
+		if (newline == string::npos) break;
 
-				currentToken = queue.front();
-				queue.pop();
+		starts.push_back(newline + 1);
+	}
 
-				currentTokenType = Utils::getTokenType(currentToken, matches);
+	starts.push_back(text.size());
 
-				if (currentTokenType != SYMBOL)
-					throw AssemblingException(line, "Directive \".equ\" expects symbol and expression!");
+	size_t count = starts.size() - 1;
 
-				if (queue.empty())
-					throw AssemblingException(line, "Missing expression in \".equ\" directive!");
+	vector<Chunk*> pieces(count);
+	vector<char> ended(count);
+	vector<thread> workers;
+	workers.reserve(count);
 
-				string expression;
-				while (!queue.empty()) {
-					expression += queue.front();
-					queue.pop();
-				}
+	for (size_t i = 0; i < count; i++) {
+		workers.emplace_back([&, i]() {
+			istringstream piece(text.substr(starts[i], starts[i + 1] - starts[i]));
+			uint32_t number = 0;
 
-				evaluateEQU(currentToken, expression, currentSection);
+			pieces[i] = new Chunk();
+			tokenize(piece, pieces[i]->source, number, SIZE_MAX);
 
-				break;
-			}
-			else if (directive == ".align") {
-				int alignment = 1;
-				if (!queue.empty()) {
-					currentToken = queue.front();
-					queue.pop();
+			// .end stops short of the newline the piece ends with
+			ended[i] = !piece.eof();
+		});
+	}
 
-					currentTokenType = Utils::getTokenType(currentToken, matches);
+	// pieces are handed over in order, with line numbers counted from the start of the file
+	uint32_t lines = 0;
+	bool stopped = false;
 
-					if (currentTokenType != OPERAND_IMMED)
-						throw AssemblingException(line, "Directive .align needs immediate operand!");
+	for (size_t i = 0; i < count; i++) {
+		workers[i].join();
 
-					alignment = strtol(matches[0].str().c_str(), NULL, 0);
-				}
-				alignment = (int)pow(2, alignment);
+		if (stopped) {
+			delete pieces[i];
+			continue;
+		}
 
-				if (!(locationCounter % alignment == 0))
-					locationCounter = locationCounter / alignment * alignment + alignment;
+		for (uint32_t& line : pieces[i]->source.lines) line += lines;
+		lines += std::count(text.begin() + starts[i], text.begin() + starts[i + 1], '\n');
 
-				break;
-			}
-			else if (directive == ".skip") {
-				int bytes = 1;
-				if (!queue.empty()) {
-					currentToken = queue.front();
-					queue.pop();
+		// statements after .end are dropped
+		bool last = pieces[i]->last = ended[i] || i + 1 == count;
+		stopped = !pushChunk(pieces[i]) || last;
+	}
+}
 
-					currentTokenType = Utils::getTokenType(currentToken, matches);
 
-					if (currentTokenType != OPERAND_IMMED)
-						throw AssemblingException(line, "Directive .skip needs immediate operand!");
+bool Assembler::pushChunk(Chunk* chunk) {
+	bool pushed = false;
 
-					bytes = strtol(matches[0].str().c_str(), NULL, 0);
-				}
-				locationCounter += bytes;
+	{
+		unique_lock<mutex> lock(chunkMutex);
+		chunkChanged.wait(lock, [&]() { return (pushed = chunks.push(chunk)) || stopReader; });
+	}
 
-				if (!queue.empty()) {
-					currentToken = queue.front();
-					queue.pop();
+	chunkChanged.notify_one();
 
-					currentTokenType = Utils::getTokenType(currentToken, matches);
+	if (!pushed) delete chunk;
 
-					if (currentTokenType != OPERAND_IMMED)
-						throw AssemblingException(line, "Illegal fill value!");
-				}
+	return pushed;
+}
 
-				break;
-			}
 
-			if (currentSection->flags[A] != '1')
-				throw AssemblingException(line, "Memory initialization in BSS section!");
+Assembler::Chunk* Assembler::popChunk() {
+	Chunk* chunk = nullptr;
 
-			if (queue.empty())
-				throw AssemblingException(line, "Missing initial value(s)!");
+	{
+		unique_lock<mutex> lock(chunkMutex);
+		chunkChanged.wait(lock, [&]() { return chunks.pop(chunk); });
+	}
 
-			int bytes = 0;
-			bool symbolPreceds = true;
-			
-			while (!queue.empty()) {
-				if (Utils::isExpression(queue.front())) {
-					if (symbolPreceds) ++bytes;
-					else symbolPreceds = true;
-				}
-				else symbolPreceds = false;
-				queue.pop();
-			}
+	chunkChanged.notify_one();
 
-			if (directive == ".byte")
-				locationCounter += bytes * BYTE;
-			else if (directive == ".word")
-				locationCounter += bytes * WORD;
-			else
-				throw AssemblingException(line, "Unexpected error!");
+	return chunk;
+}
 
-			break;
-		}
-		case INSTRUCTION: {
-			if (!currentSection || currentSection->flags[X] != '1')
-				throw AssemblingException(line, "Instruction declared outside an executable section!");
 
-			Instruction* instruction = Instruction::extract(queue, matches, line);
+shared_ptr<const Assembler::SourceFile> Assembler::loadInclude(const string& path) {
+	struct stat status;
 
-			locationCounter += instruction->size;
-			instructions.push(instruction);
+	if (stat(path.c_str(), &status) < 0 || !S_ISREG(status.st_mode)) return nullptr;
 
-			break;
-		}
-		default:
-			throw AssemblingException(line, "Invalid token!");
-			break;
-		}
+	int64_t modified = (int64_t)status.st_mtim.tv_sec * 1000000000 + status.st_mtim.tv_nsec;
 
-		if (!queue.empty())
-			throw AssemblingException(line, "Only one directive/instruction is allowed per line!");
+	{
+		lock_guard<mutex> lock(includeMutex);
+
+		auto entry = includeCache.find(path);
+
+		if (entry != includeCache.end() && entry->second.modified == modified && entry->second.size == (uint64_t)status.st_size)
+			return entry->second.source;
 	}
 
-	if (currentSection)
-		currentSection->size = locationCounter;
+	ifstream input(path, ifstream::in);
+
+	if (!input.is_open()) return nullptr;
+
+	shared_ptr<SourceFile> source = make_shared<SourceFile>();
+	uint32_t number = 0;
+	tokenize(input, *source, number, SIZE_MAX);
+
+	lock_guard<mutex> lock(includeMutex);
+	includeCache[path] = { modified, (uint64_t)status.st_size, source };
+
+	return source;
 }
 
 
-void Assembler::resolveSymbols() {
-	if (hasCycle(UST))
-		throw AssemblingException(line, "Cyclic equivalence detected!");
+void Assembler::addStatements(const SourceFile& source, uint32_t file, vector<string>& includes) {
+	smatch matches;
 
-	for (const auto& entry : UST) {
-		bool defined = true;
+	for (size_t i = 0; i < source.statements.size(); i++) {
+		const vector<string>* statement = &source.statements[i];
+		line = source.lines[i];
 
-		for (auto& relocation : entry.second->dependencies) {
-			defined &= symbolTable[relocation.first]->defined;
+		// a label in front of .rept or a macro invocation is a statement of its own
+		vector<string> unlabeled;
 
-			if (symbolTable[relocation.first]->defined) {
-				if (relocation.second == "+")
-					symbolTable[entry.first]->value += symbolTable[relocation.first]->value;
-				else
-					symbolTable[entry.first]->value -= symbolTable[relocation.first]->value;
+		if (statement->size() > 1 && statement->front().back() == ':' &&
+			((*statement)[1] == ".rept" || macros.count((*statement)[1]))) {
+			addStatement(vector<string>(1, statement->front()), line, file);
 
-				relocation.first = symbolTable[relocation.first]->section;
-			}
+			unlabeled.assign(statement->begin() + 1, statement->end());
+			statement = &unlabeled;
 		}
 
-		symbolTable[entry.first]->defined = defined;
-	}
-}
+		const vector<string>& tokens = *statement;
+		Block* block = openBlocks.back();
 
+		if (tokens[0] == ".macro") {
+			if (openBlocks.size() > 1)
+				throw AssemblingException(sourceFiles[file], line, "Macros can't be defined inside \".macro\" or \".rept\"!");
 
-bool Assembler::hasCycle(const unordered_map<string, UnresolvedSymbol*>& UST) {
-	unordered_set<std::string> visited;
-	unordered_set<std::string> recursionStack;
+			bool symbols = tokens.size() > 1;
 
-	for (const auto& entry : UST)
-		if (cycle(entry.first, visited, recursionStack))
-			return true;
+			for (size_t j = 1; j < tokens.size(); j++)
+				symbols = symbols && Utils::getTokenType(tokens[j], matches) == SYMBOL;
 
-	return false;
-}
+			if (!symbols)
+				throw AssemblingException(sourceFiles[file], line, "Directive \".macro\" expects macro name and parameter names!");
 
+			Block* macro = new Block(tokens[1], true);
+			macro->parameters.assign(tokens.begin() + 2, tokens.end());
 
-bool Assembler::cycle(const string& symbol,
-					  unordered_set<string>& visited,
-					  unordered_set<string>& recursionStack) {
-	if (!UST.count(symbol))
-		return false;
+			blocks.push_back(macro);
+			openBlocks.push_back(macro);
+			continue;
+		}
 
-	if (!visited.count(symbol)) {
-		visited.insert(symbol);
-		recursionStack.insert(symbol);
+		if (tokens[0] == ".rept") {
+			if (tokens.size() != 2 || Utils::getTokenType(tokens[1], matches) != OPERAND_IMMED || tokens[1][0] == '-')
+				throw AssemblingException(sourceFiles[file], line, "Directive \".rept\" expects repetition count!");
 
-		for (const auto& dependency : UST[symbol]->dependencies) {
-			if (!visited.count(dependency.first) && cycle(dependency.first, visited, recursionStack))
-				return true;
-			else if (recursionStack.count(dependency.first))
-				return true;
+			Block* rept = new Block(".rept", false);
+
+			block->items.push_back({ 0, rept, (uint32_t)strtoul(tokens[1].c_str(), NULL, 0), {} });
+
+			blocks.push_back(rept);
+			openBlocks.push_back(rept);
+			continue;
+		}
+
+		if (tokens[0] == ".endm" || tokens[0] == ".endr") {
+			if (tokens.size() != 1 || openBlocks.size() == 1 || block->macro != (tokens[0] == ".endm"))
+				throw AssemblingException(sourceFiles[file], line, "Unexpected \"" + tokens[0] + "\"!");
+
+			if (block->macro) macros[block->name] = block;
+
+			openBlocks.pop_back();
+			continue;
+		}
+
+		auto macro = macros.find(tokens[0]);
+
+		if (macro != macros.end()) {
+			const Block* body = macro->second;
+
+			if (tokens.size() - 1 != body->parameters.size())
+				throw AssemblingException(sourceFiles[file], line, "Macro \"" + body->name + "\" expects " + to_string(body->parameters.size()) + " argument(s)!");
+
+			block->items.push_back({ 0, body, 1, vector<string>(tokens.begin() + 1, tokens.end()) });
+			continue;
+		}
+
+		if (tokens[0] != ".include") {
+			addStatement(tokens, line, file);
+			continue;
 		}
+
+		if (tokens.size() != 2 || tokens[1].size() < 3 || tokens[1].front() != '"' || tokens[1].back() != '"')
+			throw AssemblingException(sourceFiles[file], line, "Directive \".include\" expects quoted file name!");
+
+		string path = resolvePath(tokens[1].substr(1, tokens[1].size() - 2), file);
+
+		if (includes.size() >= MAX_INCLUDE_DEPTH || find(includes.begin(), includes.end(), path) != includes.end())
+			throw AssemblingException(sourceFiles[file], line, "Recursive inclusion of file " + path + "!");
+
+		shared_ptr<const SourceFile> included = loadInclude(path);
+
+		if (!included)
+			throw AssemblingException(sourceFiles[file], line, "Can't open file " + path + "!");
+
+		uint32_t index = find(sourceFiles.begin(), sourceFiles.end(), path) - sourceFiles.begin();
+		if (index == sourceFiles.size()) sourceFiles.push_back(path);
+
+		includes.push_back(path);
+		addStatements(*included, index, includes);
+		includes.pop_back();
 	}
-	recursionStack.erase(symbol);
-	return false;
 }
 
 
-void Assembler::secondPass() {
-	line = 0;
+void Assembler::addStatement(const vector<string>& tokens, uint32_t number, uint32_t file) {
+	openBlocks.back()->items.push_back({ assembly.size(), nullptr, 1, {} });
 
-	Section* currentSection = nullptr;
+	assembly.push_back(tokens);
+	lineNumbers.push_back(number);
+	fileIndices.push_back(file);
+}
 
-	smatch matches;
-	string currentToken;
-	TokenType currentTokenType;
 
-	for (const auto& tokens : assembly) {
-		++line;
+string Assembler::resolvePath(const string& path, uint32_t file) const {
+	size_t separator = file < sourceFiles.size() ? sourceFiles[file].rfind('/') : string::npos;
 
-		queue<string> queue;
-		for (const auto& token : tokens) queue.push(token);
+	if (path[0] == '/' || separator == string::npos) return normalizePath(path);
 
-		currentToken = queue.front();
-		queue.pop();
+	return normalizePath(sourceFiles[file].substr(0, separator + 1) + path);
+}
 
-		currentTokenType = Utils::getTokenType(currentToken, matches);
 
-		if (currentTokenType == LABEL) {
-			if (queue.empty()) continue;
+void Assembler::firstPass() {
+	line = 0;
 
-			currentToken = queue.front();
-			queue.pop();
+	bool labelDefined = false;
 
-			currentTokenType = Utils::getTokenType(currentToken, matches);
-		}
+	Section* currentSection = nullptr;
 
-		switch (currentTokenType) {
-		case GLOBAL_EXTERN: {
-			string directive = currentToken;
+	merged.clear();
 
-			if (queue.empty())
-				throw AssemblingException(line, "Directive \"" + directive + "\" has no arguments!");
+	StatementCursor::Numbering numbering = { 0, 0 };
 
-			while (!queue.empty()) {
-				currentToken = queue.front();
-				queue.pop();
+	rewindInput();
 
-				currentTokenType = Utils::getTokenType(currentToken, matches);
+	do {
+		for (StatementCursor cursor(&program, assembly, numbering, chunkStart); cursor.valid(); cursor.next()) {
+			const size_t i = cursor.index();
 
-				if (currentTokenType != SYMBOL)
-					throw AssemblingException(line, "Directives \".global/.extern\" expect symbol!");
+			line = lineNumbers[cursor.source()];
+			currentFile = fileIndices[cursor.source()];
+			expanded = cursor.expanded();
 
-				if (symbolTable.count(currentToken) &&
-					symbolTable[currentToken]->defined) {
-					if (directive == ".extern")
-						throw AssemblingException(line, "Symbol \"" + currentToken + "\" defined in file but flaged as extern!");
+			try {
+				firstPassStatement(i, cursor.tokens(), currentSection, labelDefined);
+			}
+			catch (const AssemblingException& error) {
+				// the statement counts as empty and the second pass skips it
+				labelDefined = false;
+				recover(error.in(sourceFiles[currentFile]), i);
+			}
+		}
+	} while (readChunk());
 
-					symbolTable[currentToken]->scope = GLOBAL;
-				}
-				else {
-					if (directive == ".global")
-						throw AssemblingException(line, "Symbol \"" + currentToken + "\" not defined in file but flaged as global!");
+	if (currentSection) {
+		closeEntity(currentSection);
+		currentSection->size = locationCounter;
+	}
+}
 
-					addSymbol(currentToken, UNDEFINED, 0, GLOBAL, SymbolType::EXTERN, false);
-				}
-			}
 
-			break;
-		}
-		case SECTION:
-			locationCounter = 0;
+void Assembler::firstPassStatement(size_t statement, const vector<string>& tokens, Section*& currentSection, bool& labelDefined) {
+	smatch matches;
+	string currentToken;
+	TokenType currentTokenType;
 
-			if (currentToken == ".section") {
-				currentToken = queue.front();
-				queue.pop();
-			}
+	queue<string> queue;
+	for (const auto& token : tokens) queue.push(token);
 
-			currentSection = sectionTable[currentToken];
-			break;
-		case DIRECTIVE: {
-			if (!currentSection)
-				throw AssemblingException(line, "Directives are only allowed inside a section!");
+	currentToken = queue.front();
+	queue.pop();
 
-			string directive = matches[0];
+	currentTokenType = Utils::getTokenType(currentToken, matches);
 
-			if (directive == ".equ") continue;
+	if (currentTokenType == LABEL) {
+		if (labelDefined)
+			throw AssemblingException(line, "Double label definition!");
 
-			if (directive == ".align") {
-				int alignment = 1;
-				if (!queue.empty()) {
-					currentToken = queue.front();
-					queue.pop();
+		labelDefined = true;
+		string label = matches[1];
 
-					alignment = strtol(currentToken.c_str(), NULL, 0);
-				}
-				alignment = (int)pow(2, alignment);
+		if (!currentSection)
+			throw AssemblingException(line, "Label \"" + label + "\" defined outside any section!");
 
-				if (!(locationCounter % alignment == 0)) {
-					uint16_t start = locationCounter;
+		if (currentSection->flags[M] == '1' && currentSection->flags[S] != '1')
+			closeEntity(currentSection);
 
-					locationCounter = locationCounter / alignment * alignment + alignment;
+		addSymbol(label, currentSection->name, locationCounter, LOCAL, SymbolType::LABEL, true);
 
-					if (currentSection->flags[A] == '1')
-						currentSection->writeValue(start, locationCounter - start, 0);
-				}
+		if (currentSection->flags[M] == '1')
+			addLabelToEntity(label);
 
-				break;
-			}
-			else if (directive == ".skip") {
-				int bytes = 1;
-				if (!queue.empty()) {
-					currentToken = queue.front();
-					queue.pop();
+		if (queue.empty()) return;
 
-					bytes = strtol(currentToken.c_str(), NULL, 0);
-				}
+		currentToken = queue.front();
+		queue.pop();
 
-				uint16_t start = locationCounter;
-				locationCounter += bytes;
+		currentTokenType = Utils::getTokenType(currentToken, matches);
+	}
 
-				int value = 0;
+	labelDefined = false;
 
-				if (!queue.empty()) {
-					currentToken = queue.front();
-					queue.pop();
+	switch (currentTokenType) {
+	case GLOBAL_EXTERN: {
+		string directive = currentToken;
 
-					value = strtol(currentToken.c_str(), NULL, 0);
-				}
+		if (queue.empty())
+			throw AssemblingException(line, "Directive \"" + directive + "\" has no arguments!");
 
-				if (currentSection->flags[A] == '1')
-					currentSection->writeValue(start, locationCounter - start, value);
+		while (!queue.empty()) {
+			currentToken = queue.front();
+			queue.pop();
 
-				break;
-			}
+			currentTokenType = Utils::getTokenType(currentToken, matches);
 
-			while (!queue.empty()) {
-				string expression;
-				bool symbolPreceds = false;
+			if (currentTokenType != SYMBOL)
+				throw AssemblingException(line, "Directives \".global/.extern\" expect symbol!");
 
-				while (!queue.empty()) {
-					if (Utils::isExpression(queue.front())) {
-						if (symbolPreceds) {
-							break;
-						}
-						symbolPreceds = true;
-					}
-					else symbolPreceds = false;
-					expression += queue.front();
-					queue.pop();
-				}
+			// aliases are only resolved after this pass
+			if (symbolTable.count(currentToken) &&
+				(symbolTable[currentToken]->defined || UST.count(currentToken))) {
+				if (directive == ".extern")
+					throw AssemblingException(line, "Symbol \"" + currentToken + "\" defined in file but flaged as extern!");
+
+				symbolTable[currentToken]->scope = GLOBAL;
+			}
+			else {
+				addSymbol(currentToken, UNDEFINED, 0, GLOBAL, SymbolType::EXTERN, false);
+			}
+		}
+
+		break;
+	}
+	case LABEL:
+		throw AssemblingException(line, "Double label definition!");
+
+		break;
+	case SECTION: {
+		bool flagsSet = false;
+
+		string flags(10, '0');
+		string name = matches[0];
+
+		if (name == ".section") {
+			if (queue.empty())
+				throw AssemblingException(line, "Section name missing!");
+
+			currentToken = queue.front();
+			queue.pop();
+
+			currentTokenType = Utils::getTokenType(currentToken, matches);
+
+			if (currentTokenType != SYMBOL && currentTokenType != SECTION && currentTokenType != SECTION_NAME)
+				throw AssemblingException(line, "Illegal section name!");
+
+			name = matches[0];
+
+			if (!queue.empty()) {
+				currentToken = queue.front();
+				queue.pop();
+
+				currentTokenType = Utils::getTokenType(currentToken, matches);
+				if (currentTokenType != SECTION_FLAGS)
+					throw AssemblingException(line, "Illegal section flags!");
+
+				Utils::setFlags(flags, matches[0]);
+				flagsSet = true;
+			}
+		}
+
+		if (!flagsSet) {
+			if (name == ".text") {
+				flags[A] = flags[X] = '1';
+			}
+			else if (name == ".data") {
+				flags[A] = flags[W] = '1';
+			}
+			else if (name == ".bss") {
+				flags[W] = '1';
+			}
+			else if (name == ".rodata") {
+				flags[A] = '1';
+			}
+			else {
+				flags[A] = flags[W] = flags[X] = '1';
+			}
+		}
+
+		if (!queue.empty())
+			throw AssemblingException(line, "Only one directive/instruction is allowed per line!");
+
+		// a bad .section line leaves the previous section open, a defined section name throws here
+		addSymbol(name, name, 0, LOCAL, SymbolType::SECTION, true);
+		uint32_t entry = symbolTable[name]->symbolTableEntry;
+
+		if (currentSection) {
+			closeEntity(currentSection);
+			currentSection->size = locationCounter;
+		}
+
+		locationCounter = 0;
+
+		currentSection = new Section(name, sectionTable.size(), entry, flags);
+
+		addSection(currentSection);
+		break;
+	}
+	case DIRECTIVE: {
+		if (!currentSection)
+			throw AssemblingException(line, "Directives are only allowed inside a section!");
+
+		string directive = matches[0];
+
+		// labels of an entity get their final values before anything else reads them
+		if (directive != ".byte" && directive != ".word")
+			closeEntity(currentSection);
+
+		if (directive == ".equ") {
+			if (queue.empty())
+				throw AssemblingException(line, "Directive \".equ\" expects symbol and expression!");
+
+			currentToken = queue.front();
+			queue.pop();
+
+			currentTokenType = Utils::getTokenType(currentToken, matches);
+
+			if (currentTokenType != SYMBOL)
+				throw AssemblingException(line, "Directive \".equ\" expects symbol and expression!");
+
+			if (queue.empty())
+				throw AssemblingException(line, "Missing expression in \".equ\" directive!");
+
+			string expression;
+			while (!queue.empty()) {
+				if (!expression.empty()) expression += ' ';
+
+				expression += queue.front();
+				queue.pop();
+			}
+
+			evaluateEQU(currentToken, expression, currentSection);
+
+			break;
+		}
+		else if (directive == ".align") {
+			int alignment = 1;
+			if (!queue.empty()) {
+				currentToken = queue.front();
+				queue.pop();
+
+				currentTokenType = Utils::getTokenType(currentToken, matches);
+
+				if (currentTokenType != OPERAND_IMMED)
+					throw AssemblingException(line, "Directive .align needs immediate operand!");
+
+				alignment = strtol(matches[0].str().c_str(), NULL, 0);
+			}
+			alignment = (int)pow(2, alignment);
+
+			if (!(locationCounter % alignment == 0))
+				locationCounter = locationCounter / alignment * alignment + alignment;
+
+			break;
+		}
+		else if (directive == ".skip") {
+			int bytes = 1;
+			if (!queue.empty()) {
+				currentToken = queue.front();
+				queue.pop();
+
+				currentTokenType = Utils::getTokenType(currentToken, matches);
+
+				if (currentTokenType != OPERAND_IMMED)
+					throw AssemblingException(line, "Directive .skip needs immediate operand!");
+
+				bytes = strtol(matches[0].str().c_str(), NULL, 0);
+			}
+			locationCounter += bytes;
+
+			if (!queue.empty()) {
+				currentToken = queue.front();
+				queue.pop();
+
+				currentTokenType = Utils::getTokenType(currentToken, matches);
+
+				if (currentTokenType != OPERAND_IMMED)
+					throw AssemblingException(line, "Illegal fill value!");
+			}
+
+			break;
+		}
+
+		if (currentSection->flags[A] != '1')
+			throw AssemblingException(line, "Memory initialization in BSS section!");
+
+		if (directive == ".incbin") {
+			addBinary(statement, queue);
+			locationCounter += binaries[statement].length;
+
+			break;
+		}
+
+		if (queue.empty())
+			throw AssemblingException(line, "Missing initial value(s)!");
+
+		if (currentSection->flags[M] == '1')
+			addToEntity(statement, directive, queue);
+
+		int bytes = 0;
+
+		while (!queue.empty()) {
+			size_t length = Expression::length(tokens, tokens.size() - queue.size());
+			for (; length > 0; length--) queue.pop();
+
+			++bytes;
+		}
+
+		if (directive == ".byte")
+			locationCounter += bytes * BYTE;
+		else if (directive == ".word")
+			locationCounter += bytes * WORD;
+		else
+			throw AssemblingException(line, "Unexpected error!");
+
+		// strings end with their NUL terminator
+		if (currentSection->flags[S] == '1' && entity &&
+			(!entity->mergeable || (!entity->bytes.empty() && entity->bytes.back() == '\0')))
+			closeEntity(currentSection);
+
+		break;
+	}
+	case INSTRUCTION: {
+		if (!currentSection || currentSection->flags[X] != '1')
+			throw AssemblingException(line, "Instruction declared outside an executable section!");
+
+		closeEntity(currentSection);
+
+		Instruction* instruction = Instruction::extract(queue, matches, line);
+
+		// reported below, a skipped statement must not leave an instruction for the second pass
+		if (!queue.empty()) {
+			delete instruction;
+			break;
+		}
+
+		locationCounter += instruction->size;
+
+		// expansions are decoded again, so memory follows the body and not the iterations
+		if (options.stream || expanded)
+			delete instruction;
+		else
+			instructions.push(instruction);
+
+		break;
+	}
+	default:
+		throw AssemblingException(line, "Invalid token!");
+		break;
+	}
+
+	if (!queue.empty())
+		throw AssemblingException(line, "Only one directive/instruction is allowed per line!");
+}
+
+
+void Assembler::addBinary(size_t statement, queue<string>& arguments) {
+	if (arguments.empty())
+		throw AssemblingException(line, "Directive \".incbin\" expects file name!");
+
+	string path = arguments.front();
+	arguments.pop();
+
+	if (path.size() < 3 || path.front() != '"' || path.back() != '"')
+		throw AssemblingException(line, "Directive \".incbin\" expects quoted file name!");
+
+	path = resolvePath(path.substr(1, path.size() - 2), currentFile);
+
+	// offset and length, if given
+	vector<uint64_t> limits;
+	smatch matches;
+
+	while (limits.size() < 2 && !arguments.empty()) {
+		if (Utils::getTokenType(arguments.front(), matches) != OPERAND_IMMED || arguments.front()[0] == '-')
+			throw AssemblingException(line, "Directive \".incbin\" expects offset and length as immediate operands!");
+
+		limits.push_back(strtoull(arguments.front().c_str(), NULL, 0));
+		arguments.pop();
+	}
+
+	// sized from metadata only, contents are read by the second pass
+	struct stat status;
+
+	if (stat(path.c_str(), &status) < 0 || !S_ISREG(status.st_mode))
+		throw AssemblingException(line, "Can't open file " + path + "!");
+
+	uint64_t size = status.st_size;
+	uint64_t offset = limits.size() > 0 ? limits[0] : 0;
+
+	if (offset > size)
+		throw AssemblingException(line, "Offset " + to_string(offset) + " is past the end of file " + path + "!");
+
+	uint64_t length = limits.size() > 1 ? limits[1] : size - offset;
+
+	if (offset + length > size)
+		throw AssemblingException(line, "File " + path + " has less than " + to_string(length) + " bytes from offset " + to_string(offset) + "!");
+
+	if (locationCounter + length > UINT32_MAX)
+		throw AssemblingException(line, "Section too large!");
+
+	binaries[statement] = { path, offset, (uint32_t)length };
+
+	if (find(binaryFiles.begin(), binaryFiles.end(), path) == binaryFiles.end()) binaryFiles.push_back(path);
+}
+
+
+void Assembler::addToEntity(size_t statement, const string& directive, queue<string> values) {
+	if (!entity) entity = new MergeEntity(locationCounter);
+
+	entity->statements.push_back(statement);
+
+	smatch matches;
+
+	// only entities made of literal values can be compared
+	while (!values.empty() && entity->mergeable) {
+		if (Utils::getTokenType(values.front(), matches) != OPERAND_IMMED) {
+			entity->mergeable = false;
+			break;
+		}
+
+		long value = strtol(values.front().c_str(), NULL, 0);
+		values.pop();
+
+		// left to the second pass to report
+		if (value < INT16_MIN || value > UINT16_MAX) {
+			entity->mergeable = false;
+			break;
+		}
+
+		uint8_t lower  =  value & 0x00FF;
+		uint8_t higher = (value & 0xFF00) >> 8;
+
+		if (directive == ".byte") {
+			if (higher > 0) entity->mergeable = false;
+
+			entity->bytes += (char)lower;
+		}
+		else {
+			entity->bytes += (char)lower;
+			entity->bytes += (char)higher;
+		}
+	}
+}
+
+
+void Assembler::addLabelToEntity(const string& label) {
+	if (!entity) entity = new MergeEntity(locationCounter);
+
+	// a label inside a string can't be redirected to another copy
+	if (!entity->statements.empty()) entity->mergeable = false;
+
+	entity->labels.push_back(label);
+}
+
+
+void Assembler::closeEntity(Section* section) {
+	if (!entity) return;
+
+	MergeEntity* current = entity;
+	entity = nullptr;
+
+	if (current->mergeable && !current->bytes.empty()) {
+		auto& table = mergeTables[section->name];
+		auto copy = table.find(current->bytes);
+
+		if (copy == table.end()) {
+			table.insert({ current->bytes, current->start });
+		}
+		else {
+			// duplicate is dropped and its labels point at the kept copy
+			for (size_t statement : current->statements) merged.insert(statement);
+			for (const string& label : current->labels) symbolTable[label]->value = copy->second;
+
+			locationCounter = current->start;
+		}
+	}
+
+	delete current;
+}
+
+
+void Assembler::resolveSymbols() {
+	string closing;
+
+	if (hasCycle(UST, closing)) {
+		const UnresolvedSymbol* unresolved = UST[closing];
+
+		throw AssemblingException(unresolved->line, "Cyclic equivalence detected!").in(sourceFiles[unresolved->file]);
+	}
+
+	unordered_set<string> resolved;
+
+	for (const auto& entry : UST)
+		resolveSymbol(entry.first, resolved);
+
+	// aliases that folded to constants are plain constants from here on
+	for (auto entry = UST.begin(); entry != UST.end();) {
+		if (entry->second->dependencies.empty()) {
+			delete entry->second;
+			entry = UST.erase(entry);
+		}
+		else
+			++entry;
+	}
+}
+
+
+void Assembler::resolveSymbol(const string& name, unordered_set<string>& resolved) {
+	if (!resolved.insert(name).second) return;
+
+	UnresolvedSymbol* unresolved = UST[name];
+
+	for (const auto& dependency : unresolved->dependencies)
+		if (UST.count(dependency.first)) resolveSymbol(dependency.first, resolved);
+
+	Expression::Value value = fold(unresolved->expression);
+
+	Symbol* symbol = symbolTable[name];
+	symbol->value = value.constant;
+	symbol->defined = true;
+
+	unresolved->dependencies.clear();
+
+	for (const auto& term : value.terms) {
+		unresolved->dependencies.push_back({ term.symbol, term.sign < 0 ? "-" : "+" });
+
+		symbol->defined &= symbolTable[term.symbol]->defined;
+	}
+
+	if (value.terms.empty()) symbol->type = SymbolType::CONSTANT;
+}
+
+
+bool Assembler::hasCycle(const unordered_map<string, UnresolvedSymbol*>& UST, string& closing) {
+	unordered_set<std::string> visited;
+	unordered_set<std::string> recursionStack;
+
+	// walked in definition order, so the same alias is reported on every build
+	vector<const UnresolvedSymbol*> aliases;
+
+	for (const auto& entry : UST) aliases.push_back(entry.second);
+
+	sort(aliases.begin(), aliases.end(), [](const UnresolvedSymbol* a, const UnresolvedSymbol* b) {
+		return a->order < b->order;
+	});
+
+	for (const UnresolvedSymbol* alias : aliases)
+		if (cycle(alias->name, visited, recursionStack, closing))
+			return true;
+
+	return false;
+}
+
+
+bool Assembler::cycle(const string& symbol,
+					  unordered_set<string>& visited,
+					  unordered_set<string>& recursionStack,
+					  string& closing) {
+	if (!UST.count(symbol))
+		return false;
+
+	if (!visited.count(symbol)) {
+		visited.insert(symbol);
+		recursionStack.insert(symbol);
+
+		for (const auto& dependency : UST[symbol]->dependencies) {
+			if (!visited.count(dependency.first) && cycle(dependency.first, visited, recursionStack, closing))
+				return true;
+			else if (recursionStack.count(dependency.first)) {
+				closing = symbol;
+				return true;
+			}
+		}
+	}
+	recursionStack.erase(symbol);
+	return false;
+}
+
+
+void Assembler::secondPass() {
+	line = 0;
+
+	Section* currentSection = nullptr;
+
+	StatementCursor::Numbering numbering = { 0, 0 };
+
+	rewindInput();
+
+	do {
+		for (StatementCursor cursor(&program, assembly, numbering, chunkStart); cursor.valid(); cursor.next()) {
+			const size_t i = cursor.index();
+
+			if (merged.count(i) || failed.count(i)) continue;
+
+			line = lineNumbers[cursor.source()];
+			currentFile = fileIndices[cursor.source()];
+			expanded = cursor.expanded();
+
+			try {
+				secondPassStatement(i, cursor.tokens(), currentSection);
+			}
+			catch (const AssemblingException& error) {
+				recover(error.in(sourceFiles[currentFile]), i);
+			}
+
+			if (options.stream && currentSection) spill(currentSection, false);
+		}
+	} while (readChunk());
+
+	if (options.stream && currentSection) spill(currentSection, true);
+}
+
+
+void Assembler::spill(Section* section, bool finished) {
+	// memory images are bounded by the address space and written whole
+	if (!objectWriter && !options.check) return;
+
+	if (!section->bytes.empty() && (finished || section->bytes.size() >= SPILL_BYTES)) {
+		if (objectWriter) {
+			objectWriter->spillContents(section);
+		}
+		else {
+			section->spilled += section->bytes.size();
+			section->bytes.clear();
+		}
+	}
+
+	// sections are left for good, so all relocations belong to this one
+	if (finished || relocationTable.size() >= SPILL_RELOCATIONS) {
+		if (objectWriter) objectWriter->spillRelocations(section);
+
+		string rows;
+
+		for (Relocation* relocation : relocationTable) {
+			if (relocationRows) {
+				relocation->format(rows);
+				rows += '\n';
+			}
+
+			delete relocation;
+		}
+
+		relocationTable.clear();
+
+		if (relocationRows) relocationRows->append(rows);
+	}
+
+	vector<SourceLine>& lines = section->lines;
+
+	if (finished || lines.size() >= LINE_GROUP_ENTRIES + 2) {
+		size_t count = objectWriter ? objectWriter->spillLines(section, finished) : finished ? lines.size() : lines.size() - 2;
+
+		if (lineRows) {
+			string rows;
+
+			for (size_t i = 0; i < count && lines[i].offset <= section->size; i++) formatLine(rows, section, lines[i]);
+
+			lineRows->append(rows);
+		}
+
+		lines.erase(lines.begin(), lines.begin() + count);
+	}
+}
+
+
+void Assembler::secondPassStatement(size_t statement, const vector<string>& tokens, Section*& currentSection) {
+	smatch matches;
+	string currentToken;
+	TokenType currentTokenType;
+
+	const size_t relocations = relocationTable.size();
+
+	queue<string> queue;
+	for (const auto& token : tokens) queue.push(token);
+
+	currentToken = queue.front();
+	queue.pop();
+
+	currentTokenType = Utils::getTokenType(currentToken, matches);
+
+	if (currentTokenType == LABEL) {
+		if (queue.empty()) return;
+
+		currentToken = queue.front();
+		queue.pop();
+
+		currentTokenType = Utils::getTokenType(currentToken, matches);
+	}
+
+	switch (currentTokenType) {
+	case GLOBAL_EXTERN: {
+		string directive = currentToken;
+
+		if (queue.empty())
+			throw AssemblingException(line, "Directive \"" + directive + "\" has no arguments!");
+
+		while (!queue.empty()) {
+			currentToken = queue.front();
+			queue.pop();
+
+			currentTokenType = Utils::getTokenType(currentToken, matches);
+
+			if (currentTokenType != SYMBOL)
+				throw AssemblingException(line, "Directives \".global/.extern\" expect symbol!");
+
+			if (symbolTable.count(currentToken) &&
+				symbolTable[currentToken]->defined) {
+				if (directive == ".extern")
+					throw AssemblingException(line, "Symbol \"" + currentToken + "\" defined in file but flaged as extern!");
+
+				symbolTable[currentToken]->scope = GLOBAL;
+			}
+			else {
+				if (directive == ".global")
+					throw AssemblingException(line, "Symbol \"" + currentToken + "\" not defined in file but flaged as global!");
+
+				addSymbol(currentToken, UNDEFINED, 0, GLOBAL, SymbolType::EXTERN, false);
+			}
+		}
+
+		break;
+	}
+	case SECTION:
+		locationCounter = 0;
+
+		if (currentToken == ".section") {
+			currentToken = queue.front();
+			queue.pop();
+		}
+
+		if (options.stream && currentSection) spill(currentSection, true);
+
+		currentSection = sectionTable[currentToken];
+		break;
+	case DIRECTIVE: {
+		if (!currentSection)
+			throw AssemblingException(line, "Directives are only allowed inside a section!");
+
+		string directive = matches[0];
+
+		if (directive == ".equ") return;
+
+		currentSection->addLine(locationCounter, line, currentFile);
+
+		if (directive == ".align") {
+			int alignment = 1;
+			if (!queue.empty()) {
+				currentToken = queue.front();
+				queue.pop();
+
+				alignment = strtol(currentToken.c_str(), NULL, 0);
+			}
+			alignment = (int)pow(2, alignment);
+
+			if (!(locationCounter % alignment == 0)) {
+				uint32_t start = locationCounter;
+
+				locationCounter = locationCounter / alignment * alignment + alignment;
+
+				if (currentSection->flags[A] == '1')
+					currentSection->writeValue(start, locationCounter - start, 0);
+			}
+
+			break;
+		}
+		else if (directive == ".skip") {
+			int bytes = 1;
+			if (!queue.empty()) {
+				currentToken = queue.front();
+				queue.pop();
+
+				bytes = strtol(currentToken.c_str(), NULL, 0);
+			}
+
+			uint32_t start = locationCounter;
+			locationCounter += bytes;
+
+			int value = 0;
+
+			if (!queue.empty()) {
+				currentToken = queue.front();
+				queue.pop();
+
+				value = strtol(currentToken.c_str(), NULL, 0);
+			}
+
+			if (currentSection->flags[A] == '1')
+				currentSection->writeValue(start, locationCounter - start, value);
+
+			break;
+		}
+		else if (directive == ".incbin") {
+			const Binary& binary = binaries[statement];
+
+			ifstream input(binary.path, ifstream::in | ifstream::binary);
+			input.seekg(binary.offset);
+
+			// read straight into the section, no per byte statements; streaming
+			// hands it over a piece at a time
+			for (uint32_t done = 0; done < binary.length;) {
+				uint32_t length = binary.length - done;
+				if (options.stream) length = min<uint32_t>(length, SPILL_BYTES);
+
+				uint8_t* destination = currentSection->allocate(locationCounter, length);
+
+				if (!input.read((char*)destination, length))
+					throw AssemblingException(line, "Can't read file " + binary.path + "!");
+
+				locationCounter += length;
+				done += length;
+
+				if (options.stream) spill(currentSection, false);
+			}
+
+			break;
+		}
+
+		while (!queue.empty()) {
+			size_t literals = writeLiterals(directive, tokens, tokens.size() - queue.size(), currentSection);
+			for (; literals > 0; literals--) queue.pop();
+
+			if (queue.empty()) break;
+
+			size_t length = Expression::length(tokens, tokens.size() - queue.size());
+
+			string expression;
+			for (; length > 0; length--) {
+				if (!expression.empty()) expression += ' ';
+
+				expression += queue.front();
+				queue.pop();
+			}
+
+			evaluate(directive, expression, currentSection);
+		}
+
+		break;
+	}
+	case INSTRUCTION: {
+		// released even when its code can't be generated
+		unique_ptr<Instruction> instruction;
+
+		if (options.stream || expanded)
+			instruction.reset(Instruction::extract(queue, matches, line));
+		else {
+			instruction.reset(instructions.front());
+			instructions.pop();
+		}
+
+		currentSection->addLine(locationCounter, line, currentFile);
+
+		generateInstructionCode(instruction.get(), currentSection);
+
+		locationCounter += instruction->size;
+
+		break;
+	}
+	default:
+		throw AssemblingException(line, "Invalid token!");
+		break;
+	}
+
+	if (options.pic) reportAbsolute(relocations);
+}
+
+
+void Assembler::recover(const AssemblingException& error, size_t statement) {
+	// with the default limit the first error stops assembling
+	if (options.errorLimit == 1) throw error;
+
+	diagnostics.push_back({ statement, error.what() });
+	failed.insert(statement);
+
+	if (diagnostics.size() == options.errorLimit)
+		throw AssemblingException("Stopped after " + to_string(diagnostics.size()) + " errors!");
+}
 
-				evaluate(directive, expression, currentSection);
-			}
 
-			break;
-		}
-		case INSTRUCTION: {
-			Instruction* instruction = instructions.front();
-			instructions.pop();
+void Assembler::reportErrors() {
+	// errors of the second pass are found after all of the first, print them in program order
+	stable_sort(diagnostics.begin(), diagnostics.end(), [](const pair<size_t, string>& a, const pair<size_t, string>& b) {
+		return a.first < b.first;
+	});
 
-			generateInstructionCode(instruction, currentSection);
+	for (const auto& diagnostic : diagnostics)
+		cerr << diagnostic.second << "\n\n";
+}
 
-			locationCounter += instruction->size;
-			delete instruction;
 
-			break;
-		}
-		default:
-			throw AssemblingException(line, "Invalid token!");
-			break;
-		}
+void Assembler::reportAbsolute(size_t first) const {
+	for (size_t i = first; i < relocationTable.size(); i++) {
+		const Relocation* relocation = relocationTable[i];
+
+		if (relocation->type == R_386_PC16 || relocation->type == R_386_SUB_PC16) continue;
+
+		cerr << "ASSEMBLING WARNING(" << sourceFiles[currentFile] << ":" << line << "): Absolute reference to \"" << relocation->symbol
+			 << "\" can't be made PC relative!\n";
 	}
 }
 
@@ -587,403 +1491,322 @@ void Assembler::writeELF(const string& file) {
 	if (!output.is_open())
 		throw AssemblingException("Can't open file " + file + "!");
 
-	size_t size = symbolTable.size();
-	output.write((char*)& size, sizeof(size_t));
+	// a streamed object already holds its sections
+	if (!objectWriter) objectWriter = createWriter(file);
+
+	// written as it is laid out, the object is never held in memory a second time
+	objectWriter->write(output);
+	output.flush();
+}
+
+
+unique_ptr<ObjectWriter> Assembler::createWriter(const string& file) const {
+	unique_ptr<ObjectWriter> writer(new ObjectWriter(symbolTable, sectionTable, relocationTable));
+	writer->setHashIndex(options.hashIndex);
+	writer->setCompression(options.compress);
+	writer->setSourceFiles(sourceFiles);
+
+	if (options.ifChanged) {
+		vector<pair<string, uint64_t>> stamp(1, { "", optionsHash(file) });
+
+		for (const string& input : inputFiles()) stamp.push_back({ input, hashFile(input) });
+
+		writer->setStamp(stamp);
+	}
+
+	return writer;
+}
 
-	for (const auto& entry : symbolTable)
-		entry.second->serialize(output);
 
-	size = sectionTable.size();
-	output.write((char*)& size, sizeof(size_t));
+void Assembler::writeImage(const string& file) {
+	ofstream output(file, ofstream::out | ofstream::trunc | ofstream::binary);
 
-	for (const auto& entry : sectionTable)
-		entry.second->serialize(output);
+	if (!output.is_open())
+		throw AssemblingException("Can't open file " + file + "!");
 
-	size = relocationTable.size();
-	output.write((char*)& size, sizeof(size_t));
+	string buffer;
 
-	for (const auto& relocation : relocationTable)
-		relocation->serialize(output);
+	ImageWriter writer(symbolTable, sectionTable, relocationTable);
+	for (const auto& entry : options.sectionStarts) writer.setSectionStart(entry.first, entry.second);
+	writer.write(buffer, options.format);
 
+	output.write(buffer.data(), buffer.size());
 	output.flush();
 }
 
 
 void Assembler::writeText(const string& file) {
-	ofstream output(file, ofstream::out | ofstream::trunc);
+	ofstream output(file, ofstream::out | ofstream::trunc | ofstream::binary);
 
 	if (!output.is_open())
 		throw AssemblingException("Can't open file " + file + "!");
 
-	for (const auto& entry : sectionTable) {
-		if (entry.second->bytes.empty()) continue;
-
-		output << "/*** Section \"" + entry.first + "\" ***/\n\n";
-		output << entry.second->getBytes() << endl;
-	}
-
-	output << "/*** Symbol Table ***/\n\n";
-	output << left
-		   << setw(WIDTH) << "Entry"
-		   << setw(WIDTH) << "Name"
-		   << setw(WIDTH) << "Section"
-		   << setw(WIDTH) << "Value"
-		   << setw(WIDTH) << "Scope"
-		   << setw(WIDTH) << "Type" << endl;
-
-	for (int i = 0; i < symbolTable.size(); i++) {
-		for (const auto& entry : symbolTable)
-			if (entry.second->symbolTableEntry == i) {
-				output << *entry.second << endl;
-				break;
-			}
-	}
+	// tables are ordered by their entry numbers
+	vector<const Symbol*>  symbols;
+	vector<const Section*> sections;
 
-	output << endl;
-	output << "/*** Section Table ***/\n\n";
-	output << left
-		   << setw(WIDTH) << "Entry"
-		   << setw(WIDTH) << "Name"
-		   << setw(WIDTH) << "Size"
-		   << setw(WIDTH) << "WAXMSILGTE"
-		   << setw(WIDTH) << "SymbolTableEntry" << endl;
-
-	for (int i = 0; i < sectionTable.size(); i++) {
-		for (const auto& entry : sectionTable)
-			if (entry.second->sectionTableEntry == i) {
-				output << *entry.second << endl;
-				break;
-			}
-	}
+	size_t capacity = 0;
+
+	for (const auto& entry : symbolTable) symbols.push_back(entry.second);
 
-	if (!relocationTable.empty()) {
-		output << endl;
-		output << "/*** Relocation Table ***/\n\n";
-		output << left
-			<< setw(WIDTH) << "Symbol"
-			<< setw(WIDTH) << "Section"
-			<< setw(WIDTH) << "Offset"
-			<< setw(WIDTH) << "Type" << endl;
+	for (const auto& entry : sectionTable) {
+		sections.push_back(entry.second);
 
-		for (const auto& relocation : relocationTable)
-			output << *relocation << endl;
+		capacity += entry.second->bytes.size() * 3 + 64;
 	}
 
-	output.flush();
-}
+	sort(symbols.begin(), symbols.end(), [](const Symbol* a, const Symbol* b) {
+		return a->symbolTableEntry < b->symbolTableEntry;
+	});
 
+	sort(sections.begin(), sections.end(), [](const Section* a, const Section* b) {
+		return a->sectionTableEntry < b->sectionTableEntry;
+	});
 
-void Assembler::addSymbol(const string& name,
-						  const string& section,
-						  int16_t value,
-						  ScopeType scope,
-						  SymbolType type,
-						  bool defined) {
-	if ((symbolTable.count(name) && symbolTable[name]->defined) || UST.count(name))
-		throw AssemblingException(line, "Symbol \"" + name + "\" is already defined!");
+	capacity += (symbols.size() + sections.size() + relocationTable.size() + 8) * WIDTH * 6;
 
-	if (symbolTable.count(name)) {
-		symbolTable[name]->setData(section, value, scope, type, defined);
-	}
-	else {
-		Symbol* symbol = new Symbol(name, section, value, scope, type, defined);
-		symbolTable.insert({ name, symbol });
-	}
-}
+	string text;
+	text.reserve(capacity);
 
+	for (const auto& entry : sectionTable) {
+		const Section* section = entry.second;
 
-void Assembler::addSection(Section* section) {
-	if (sectionTable.count(section->name))
-		throw AssemblingException(line, "Section \"" + section->name + "\" is already defined!");
+		if (section->spilled == 0 && section->bytes.empty()) continue;
 
-	sectionTable.insert({ section->name, section });
-}
+		text += "/*** Section \"" + entry.first + "\" ***/\n\n";
 
+		// streamed contents are dumped as they are read back
+		if (section->spilled > 0) {
+			objectWriter->spilledContents(section, [&](const char* data, size_t size) {
+				Utils::appendHexDump(text, (const uint8_t*)data, size);
 
-void Assembler::evaluate(const string& directive, const string& expression, Section* section) {
-	smatch matches;
-	TokenType type = Utils::getTokenType(expression, matches);
+				output.write(text.data(), text.size());
+				text.clear();
+			});
+		}
+		else {
+			section->formatBytes(text);
+		}
 
-	int16_t value = 0;
-	RelocationType relocationType = directive == ".byte" ? R_386_8 : R_386_16;
+		text += '\n';
+	}
 
-	switch (type) {
-	case OPERAND_IMMED: {
-		value = strtol(expression.c_str(), NULL, 0);
+	text += "/*** Symbol Table ***/\n\n";
+	Utils::appendColumn(text, "Entry");
+	Utils::appendColumn(text, "Name");
+	Utils::appendColumn(text, "Section");
+	Utils::appendColumn(text, "Value");
+	Utils::appendColumn(text, "Scope");
+	Utils::appendColumn(text, "Type");
+	text += '\n';
 
-		break;
-	}
-	case SYMBOL: {
-		string symbol = expression;
+	for (const Symbol* symbol : symbols) {
+		if (!symbol) continue;
 
-		if (UST.count(symbol)) {
-			value = symbolTable[symbol]->value;
+		symbol->format(text);
+		text += '\n';
+	}
 
-			for (const auto& relocation : UST[symbol]->dependencies) {
-				RelocationType type = relocationType;
+	text += '\n';
+	text += "/*** Section Table ***/\n\n";
+	Utils::appendColumn(text, "Entry");
+	Utils::appendColumn(text, "Name");
+	Utils::appendColumn(text, "Size");
+	Utils::appendColumn(text, "WAXMSILGTE");
+	Utils::appendColumn(text, "SymbolTableEntry");
+	text += '\n';
 
-				if (relocation.second == "-")
-					type = (RelocationType)(type + 1);
+	for (const Section* section : sections) {
+		if (!section) continue;
 
-				relocationTable.push_back(new Relocation(relocation.first, section->name, locationCounter, type));
-			}
-		}
-		else {
-			if (symbolTable.count(symbol)) {
-				if (symbolTable[symbol]->scope == LOCAL) {
-					value = symbolTable[symbol]->value;
+		section->format(text);
+		text += '\n';
+	}
 
-					if (symbolTable[symbol]->type == SymbolType::CONSTANT) break;
+	if (!relocationTable.empty() || (relocationRows && relocationRows->size() > 0)) {
+		text += '\n';
+		text += "/*** Relocation Table ***/\n\n";
+		Utils::appendColumn(text, "Symbol");
+		Utils::appendColumn(text, "Section");
+		Utils::appendColumn(text, "Offset");
+		Utils::appendColumn(text, "Type");
+		text += '\n';
 
-					symbol = symbolTable[symbol]->section;
-				}
-			}
-			else {
-				addSymbol(symbol, UNDEFINED, 0, GLOBAL, SymbolType::EXTERN, false);
-			}
+		if (relocationRows) {
+			output.write(text.data(), text.size());
+			text.clear();
 
-			relocationTable.push_back(new Relocation(symbol, section->name, locationCounter, relocationType));
+			relocationRows->copy(0, relocationRows->size(), [&output](const char* data, size_t size) { output.write(data, size); });
 		}
-		
 
-		break;
+		for (const auto& relocation : relocationTable) {
+			relocation->format(text);
+			text += '\n';
+		}
 	}
-	case EXPRESSION: {
-		smatch match;
 
-		string first = matches[1];
-		TokenType firstType = Utils::getTokenType(first, match);
+	bool lines = lineRows && lineRows->size() > 0;
+	for (const Section* section : sections) lines |= section && !section->lines.empty();
 
-		string operation = matches[2];
+	if (lines) {
+		text += '\n';
+		text += "/*** Line Table ***/\n\n";
+		Utils::appendColumn(text, "Section");
+		Utils::appendColumn(text, "Offset");
+		Utils::appendColumn(text, "Line");
+		text += "File\n";
 
-		string second = matches[3];
-		TokenType secondType = Utils::getTokenType(second, match);
+		if (lineRows) {
+			output.write(text.data(), text.size());
+			text.clear();
 
-		switch (firstType) {
-		case OPERAND_IMMED:
-			switch (secondType) {
-			case OPERAND_IMMED: {
-				int16_t operand1 = strtol(first.c_str(),  NULL, 0);
-				int16_t operand2 = strtol(second.c_str(), NULL, 0);
+			lineRows->copy(0, lineRows->size(), [&output](const char* data, size_t size) { output.write(data, size); });
+		}
 
-				if (operation == "+")
-					value = operand1 + operand2;
+		for (const Section* section : sections) {
+			if (!section) continue;
 
-				else if (operation == "-")
-					value = operand1 = operand2;
+			// an entry at the end belongs to a last statement of no size
+			for (const SourceLine& entry : section->lines) {
+				if (entry.offset > section->size) break;
 
-				else
-					throw AssemblingException(line, "Unexpected error!");
+				formatLine(text, section, entry);
 			}
-			case SYMBOL: {
-				value = strtol(first.c_str(), NULL, 0);
-
-				if (operation == "-" && directive == ".byte")
-					relocationType = R_386_SUB_8;
-
-				else if (operation == "-")
-					relocationType = R_386_SUB_16;
+		}
+	}
 
-				if (UST.count(second)) {
-					if (operation == "+")
-						value += symbolTable[second]->value;
-					else
-						value -= symbolTable[second]->value;
+	output.write(text.data(), text.size());
+	output.flush();
+}
 
-					for (const auto& relocation : UST[second]->dependencies) {
-						RelocationType type = relocationType;
 
-						if (operation == "+" && relocation.second == "-")
-							type = (RelocationType)(type + 1);
+void Assembler::formatLine(string& out, const Section* section, const SourceLine& entry) const {
+	Utils::appendColumn(out, section->name);
+	Utils::appendColumn(out, entry.offset);
+	Utils::appendColumn(out, entry.line);
+	out += sourceFiles[entry.file];
+	out += '\n';
+}
 
-						else if (operation == "-" && relocation.second == "-")
-							type = (RelocationType)(type - 1);
 
-						relocationTable.push_back(new Relocation(relocation.first, section->name, locationCounter, type));
-					}
-				}
-				else {
-					if (symbolTable.count(second)) {
-						if (symbolTable[second]->scope == LOCAL) {
-							if (operation == "+")
-								value += symbolTable[second]->value;
-							else
-								value -= symbolTable[second]->value;
+void Assembler::writeDependencies(const string& file, const string& target) const {
+	ofstream output(file, ofstream::out | ofstream::trunc | ofstream::binary);
 
-							if (symbolTable[second]->type == SymbolType::CONSTANT) break;
+	if (!output.is_open())
+		throw AssemblingException("Can't open file " + file + "!");
 
-							second = symbolTable[second]->section;
-						}
-					}
-					else {
-						addSymbol(second, UNDEFINED, 0, GLOBAL, SymbolType::EXTERN, false);
-					}
+	// make reads spaces as separators, # as a comment and $ as a variable
+	auto escape = [](const string& path) {
+		string escaped;
 
-					relocationTable.push_back(new Relocation(second, section->name, locationCounter, relocationType));
-				}
+		for (char c : path) {
+			if (c == ' ' || c == '#') escaped += '\\';
+			if (c == '$') escaped += '$';
 
-				break;
-			}
-			default:
-				throw AssemblingException(line, "Invalid operand type in expression!");
-				break;
-			}
+			escaped += c;
+		}
 
-			break;
-		case SYMBOL:
-			switch (secondType) {
-			case OPERAND_IMMED: {
-				value = strtol(second.c_str(), NULL, 0);
+		return escaped;
+	};
 
-				if (operation == "-") value = ~value;
+	string rule = escape(target) + ":";
 
-				if (UST.count(first)) {
-					value += symbolTable[first]->value;
+	for (const string& input : inputFiles()) rule += " \\\n " + escape(input);
 
-					for (const auto& relocation : UST[first]->dependencies) {
-						RelocationType type = relocationType;
+	rule += '\n';
+	output.write(rule.data(), rule.size());
+}
 
-						if (relocation.second == "-")
-							type = (RelocationType)(type + 1);
 
-						relocationTable.push_back(new Relocation(relocation.first, section->name, locationCounter, type));
-					}
-				}
-				else {
-					if (symbolTable.count(first)) {
-						if (symbolTable[first]->scope == LOCAL) {
-							value += symbolTable[first]->value;
+vector<string> Assembler::inputFiles() const {
+	vector<string> files = sourceFiles;
 
-							if (symbolTable[first]->type == SymbolType::CONSTANT) break;
+	for (const string& binary : binaryFiles)
+		if (find(files.begin(), files.end(), binary) == files.end()) files.push_back(binary);
 
-							first = symbolTable[first]->section;
-						}
-					}
-					else {
-						addSymbol(first, UNDEFINED, 0, GLOBAL, SymbolType::EXTERN, false);
-					}
+	return files;
+}
 
-					relocationTable.push_back(new Relocation(first, section->name, locationCounter, relocationType));
-				}
 
-				break;
-			}
-			case SYMBOL: {
-				Symbol* symbol1 = symbolTable.count(first)  ? symbolTable[first]  : nullptr;
-				Symbol* symbol2 = symbolTable.count(second) ? symbolTable[second] : nullptr;
-
-				if (symbol1 &&
-					symbol2 &&
-					!UST.count(first)  &&
-					!UST.count(second) &&
-					symbol1->section == symbol2->section &&
-					operation == "-") {
-					value = symbol1->value - symbol2->value;
-					break;
-				}
+uint64_t Assembler::optionsHash(const string& output) const {
+	string settings = output + '\n' + to_string(options.listing) + to_string(options.hashIndex) + to_string(options.pic) +
+		to_string(options.compress) + to_string(options.dependencies) + options.dependencyFile;
 
-				if (UST.count(first)) {
-					value += symbolTable[first]->value;
+	return Utils::hash64((const uint8_t*)settings.data(), settings.size());
+}
 
-					for (const auto& relocation : UST[first]->dependencies) {
-						RelocationType type = relocationType;
 
-						if (relocation.second == "-")
-							type = (RelocationType)(type + 1);
+bool Assembler::upToDate(const string& input, const string& output) const {
+	struct stat status;
 
-						relocationTable.push_back(new Relocation(relocation.first, section->name, locationCounter, type));
-					}
-				}
-				else {
-					bool constant = false;
+	if (options.listing && stat((output.substr(0, output.rfind('.')) + ".txt").c_str(), &status) < 0) return false;
 
-					if (symbol1) {
-						if (symbol1->scope == LOCAL) {
-							value += symbol1->value;
+	if (options.dependencies &&
+		stat((options.dependencyFile.empty() ? output.substr(0, output.rfind('.')) + ".d" : options.dependencyFile).c_str(), &status) < 0)
+		return false;
 
-							if (symbol1->type == SymbolType::CONSTANT)
-								constant = true;
+	try {
+		MappedObjectFile object(output);
+		object.validate();
 
-							first = symbol1->section;
-						}
-					}
-					else {
-						addSymbol(first, UNDEFINED, 0, GLOBAL, SymbolType::EXTERN, false);
-					}
+		TableView<StampEntry> stamp = object.stamp();
 
-					if (!constant)
-						relocationTable.push_back(new Relocation(first, section->name, locationCounter, relocationType));
-				}
-				if (operation == "-" && directive == ".byte")
-					relocationType = R_386_SUB_8;
+		// options first, then the main file
+		if (stamp.size() < 2 || object.getString(stamp[0].file)[0] || littleEndian(stamp[0].hash) != optionsHash(output) ||
+			input != object.getString(stamp[1].file))
+			return false;
 
-				else if (operation == "-")
-					relocationType = R_386_SUB_16;
+		for (uint32_t i = 1; i < stamp.size(); i++)
+			if (littleEndian(stamp[i].hash) != hashFile(object.getString(stamp[i].file))) return false;
+	}
+	catch (const exception&) {
+		return false;
+	}
 
-				if (UST.count(second)) {
-					if (operation == "+")
-						value += symbolTable[second]->value;
-					else
-						value -= symbolTable[second]->value;
+	return true;
+}
 
-					for (const auto& relocation : UST[second]->dependencies) {
-						RelocationType type = relocationType;
 
-						if (operation == "+" && relocation.second == "-")
-							type = (RelocationType)(type + 1);
+void Assembler::addSymbol(const string& name,
+						  const string& section,
+						  int32_t value,
+						  ScopeType scope,
+						  SymbolType type,
+						  bool defined) {
+	if ((symbolTable.count(name) && symbolTable[name]->defined) || UST.count(name))
+		throw AssemblingException(line, "Symbol \"" + name + "\" is already defined!");
 
-						else if (operation == "-" && relocation.second == "-")
-							type = (RelocationType)(type - 1);
+	if (symbolTable.count(name)) {
+		symbolTable[name]->setData(section, value, scope, type, defined);
+	}
+	else {
+		Symbol* symbol = new Symbol(name, symbolTable.size(), section, value, scope, type, defined);
+		symbolTable.insert({ name, symbol });
+	}
+}
 
-						relocationTable.push_back(new Relocation(relocation.first, section->name, locationCounter, type));
-					}
-				}
-				else {
-					bool constant = false;
 
-					if (symbol2) {
-						if (symbol2->scope == LOCAL) {
-							if (operation == "+")
-								value += symbol2->value;
-							else
-								value -= symbol2->value;
+void Assembler::addSection(Section* section) {
+	if (sectionTable.count(section->name))
+		throw AssemblingException(line, "Section \"" + section->name + "\" is already defined!");
 
-							if (symbol2->type == SymbolType::CONSTANT)
-								constant = true;
+	sectionTable.insert({ section->name, section });
+}
 
-							second = symbol2->section;
-						}
-					}
-					else {
-						addSymbol(second, UNDEFINED, 0, GLOBAL, SymbolType::EXTERN, false);
-					}
 
-					if (!constant)
-						relocationTable.push_back(new Relocation(second, section->name, locationCounter, relocationType));
-				}
+void Assembler::evaluate(const string& directive, const string& expression, Section* section) {
+	Expression::Value value = fold(Expression(expression, line));
 
-				break;
-			}
-			default:
-				throw AssemblingException(line, "Invalid operand type in expression!");
-				break;
-			}
+	RelocationType relocationType = directive == ".byte" ? R_386_8 : R_386_16;
 
-			break;
-		default:
-			throw AssemblingException(line, "Invalid operand type in expression!");
-			break;
-		}
+	for (const auto& term : value.terms) {
+		RelocationType type = term.sign < 0 ? (RelocationType)(relocationType + 1) : relocationType;
 
-		break;
-	}
-	default:
-		throw AssemblingException(line, "Invalid expression!");
-		break;
+		relocationTable.push_back(new Relocation(term.symbol, section->name, locationCounter, type));
 	}
 
-	uint8_t lower  =  value & 0x00FF;
-	uint8_t higher = (value & 0xFF00) >> 8;
+	uint8_t lower  =  toWord(value.constant) & 0x00FF;
+	uint8_t higher = (value.constant & 0xFF00) >> 8;
 
 	if (directive == ".byte") {
 		if (higher > 0)
@@ -1003,286 +1826,172 @@ void Assembler::evaluate(const string& directive, const string& expression, Sect
 }
 
 
-void Assembler::evaluateEQU(const std::string& symbol, const std::string& expression, Section* section) {
-	smatch matches;
-	TokenType type = Utils::getTokenType(expression, matches);
+size_t Assembler::writeLiterals(const string& directive, const vector<string>& values, size_t first, Section* section) {
+	const bool byte = directive == ".byte";
 
-	switch (type) {
-	case OPERAND_IMMED: {
-		int16_t value = strtol(expression.c_str(), NULL, 0);
+	vector<uint8_t> bytes;
+	bytes.reserve((values.size() - first) * (byte ? BYTE : WORD));
 
-		addSymbol(symbol, section->name, value, LOCAL, SymbolType::CONSTANT, true);
+	int64_t value = 0;
+	int64_t next = 0;
 
-		break;
-	}
-	case SYMBOL: {
-		int16_t value = 0;
-		string source = expression;
+	size_t i = first;
+	bool literal = i < values.size() && Utils::parseLiteral(values[i], value);
 
-		bool defined = false;
+	while (literal) {
+		bool last = i + 1 == values.size();
+		bool nextLiteral = !last && Utils::parseLiteral(values[i + 1], next);
 
-		if (UST.count(source)) {
-			value = symbolTable[source]->value;
-			defined = symbolTable[source]->defined;
-		}
-		else if (symbolTable.count(source)) {
-			if (symbolTable[source]->scope == LOCAL) {
-				value = symbolTable[source]->value;
+		// operand of an expression ("1 + 2")
+		if (!last && !nextLiteral) break;
 
-				if (symbolTable[source]->type == SymbolType::CONSTANT) {
-					addSymbol(symbol, section->name, value, LOCAL, SymbolType::CONSTANT, true);
-					break;
-				}
+		uint8_t lower  =  toWord(value) & 0x00FF;
+		uint8_t higher = (value & 0xFF00) >> 8;
 
-				source = symbolTable[source]->section;
-				defined = true;
-			}
+		if (byte) {
+			if (higher > 0)
+				throw AssemblingException(line, "Byte sized initial value expected!");
+
+			bytes.push_back(lower);
 		}
 		else {
-			addSymbol(source, UNDEFINED, 0, GLOBAL, SymbolType::EXTERN, false);
+			bytes.push_back(lower);
+			bytes.push_back(higher);
 		}
 
-		addSymbol(symbol, section->name, value, LOCAL, SymbolType::ALIAS, defined);
-
-		UST.insert({ symbol, new UnresolvedSymbol(symbol, section) });
-
-		if (UST.count(source))
-			UST[symbol]->dependencies = UST[source]->dependencies;
-		else
-			UST[symbol]->dependencies.push_back({ source, "+" });
-
-		break;
+		++i;
+		value = next;
+		literal = nextLiteral;
 	}
-	case EXPRESSION: {
-		smatch match;
-
-		string first = matches[1];
-		TokenType firstType = Utils::getTokenType(first, match);
-
-		string operation = matches[2];
-
-		string second = matches[3];
-		TokenType secondType = Utils::getTokenType(second, match);
-
-		switch (firstType) {
-		case OPERAND_IMMED:
-			switch (secondType) {
-			case OPERAND_IMMED: {
-				int16_t operand1 = strtol(first.c_str(),  NULL, 0);
-				int16_t operand2 = strtol(second.c_str(), NULL, 0);
 
-				if (operation == "+")
-					operand1 += operand2;
-				else
-					operand1 -= operand2;
-
-				addSymbol(symbol, section->name, operand1, LOCAL, SymbolType::CONSTANT, true);
-
-				break;
-			}
-			case SYMBOL: {
-				int16_t value = strtol(first.c_str(), NULL, 0);
-
-				bool defined = false;
+	if (!bytes.empty()) {
+		section->write(locationCounter, bytes);
+		locationCounter += bytes.size();
+	}
 
-				if (UST.count(second)) {
-					if (operation == "+")
-						value += symbolTable[second]->value;
-					else
-						value -= symbolTable[second]->value;
+	return i - first;
+}
 
-					defined = symbolTable[second]->defined;
-				}
-				else if (symbolTable.count(second)) {
-					if (symbolTable[second]->scope == LOCAL) {
-						if (operation == "+")
-							value += symbolTable[second]->value;
-						else
-							value -= symbolTable[second]->value;
 
-						if (symbolTable[second]->type == SymbolType::CONSTANT) {
-							addSymbol(symbol, section->name, value, LOCAL, SymbolType::CONSTANT, true);
-							break;
-						}
+void Assembler::evaluateEQU(const std::string& symbol, const std::string& expression, Section* section) {
+	Expression parsed(expression, line);
 
-						second = symbolTable[second]->section;
-						defined = true;
-					}
-				}
-				else {
-					addSymbol(second, UNDEFINED, 0, GLOBAL, SymbolType::EXTERN, false);
-				}
+	if (parsed.symbols().empty()) {
+		addSymbol(symbol, section->name, fold(parsed).constant, LOCAL, SymbolType::CONSTANT, true);
+		return;
+	}
 
-				addSymbol(symbol, section->name, value, LOCAL, SymbolType::ALIAS, defined);
+	for (const auto& name : parsed.symbols())
+		if (!symbolTable.count(name)) addSymbol(name, UNDEFINED, 0, GLOBAL, SymbolType::EXTERN, false);
 
-				UST.insert({ symbol, new UnresolvedSymbol(symbol, section) });
+	// labels may still be defined further on, the value is folded by resolveSymbols
+	addSymbol(symbol, section->name, 0, LOCAL, SymbolType::ALIAS, false);
 
-				if (UST.count(second))
-					UST[symbol]->dependencies = UST[second]->dependencies;
-				else
-					UST[symbol]->dependencies.push_back({ second, operation });
+	UnresolvedSymbol* unresolved = new UnresolvedSymbol(symbol, section, parsed, line, currentFile, UST.size());
 
-				break;
-			}
-			default:
-				throw AssemblingException(line, "Invalid operand type in expression!");
-				break;
-			}
+	for (const auto& name : parsed.symbols())
+		unresolved->dependencies.push_back({ name, "+" });
 
-			break;
-		case SYMBOL:
-			switch (secondType) {
-			case OPERAND_IMMED: {
-				int16_t value = strtol(second.c_str(), NULL, 0);
+	UST.insert({ symbol, unresolved });
+}
 
-				if (operation == "-") value = ~value;
 
-				bool defined = false;
+Expression::Value Assembler::fold(const Expression& expression) {
+	return expression.evaluate([this](const string& name) { return reference(name); });
+}
 
-				if (UST.count(first)) {
-					value += symbolTable[first]->value;
-					defined = symbolTable[first]->defined;
-				}
-				else if (symbolTable.count(first)) {
-					if (symbolTable[first]->scope == LOCAL) {
-						value += symbolTable[first]->value;
 
-						if (symbolTable[first]->type == SymbolType::CONSTANT) {
-							addSymbol(symbol, section->name, value, LOCAL, SymbolType::CONSTANT, true);
-							break;
-						}
+Expression::Value Assembler::reference(const string& name) {
+	Expression::Value value;
 
-						first = symbolTable[first]->section;
-						defined = true;
-					}
-				}
-				else {
-					addSymbol(first, UNDEFINED, 0, GLOBAL, SymbolType::EXTERN, false);
-				}
+	if (UST.count(name)) {
+		value.constant = symbolTable[name]->value;
 
-				addSymbol(symbol, section->name, value, LOCAL, SymbolType::ALIAS, defined);
+		for (const auto& dependency : UST[name]->dependencies)
+			value.add(term(dependency.first, dependency.second == "-" ? -1 : 1));
 
-				UST.insert({ symbol, new UnresolvedSymbol(symbol, section) });
+		return value;
+	}
 
-				if (UST.count(first))
-					UST[symbol]->dependencies = UST[first]->dependencies;
-				else
-					UST[symbol]->dependencies.push_back({ first, "+" });
+	if (!symbolTable.count(name))
+		addSymbol(name, UNDEFINED, 0, GLOBAL, SymbolType::EXTERN, false);
 
-				break;
-			}
-			case SYMBOL: {
-				int16_t value = 0;
+	const Symbol* symbol = symbolTable[name];
 
-				Symbol* symbol1 = symbolTable.count(first)  ? symbolTable[first]  : nullptr;
-				Symbol* symbol2 = symbolTable.count(second) ? symbolTable[second] : nullptr;
+	// local symbols are relocated through their section, constants need nothing
+	if (symbol->scope == LOCAL) {
+		value.constant = symbol->value;
 
-				if (symbol1 &&
-					symbol2 &&
-					!UST.count(first)  &&
-					!UST.count(second) &&
-					symbol1->section == symbol2->section &&
-					operation == "-") {
-					value = symbol1->value - symbol2->value;
+		if (symbol->type != SymbolType::CONSTANT)
+			value.add(term(symbol->section, 1));
+	}
+	else
+		value.add(term(name, 1));
 
-					addSymbol(symbol, section->name, value, LOCAL, SymbolType::CONSTANT, true);
+	return value;
+}
 
-					break;
-				}
 
-				bool defined = false;
-				bool constant1 = false;
-				bool constant2 = false;
+Expression::Term Assembler::term(const string& symbol, int sign) const {
+	const Symbol* entry = symbolTable.at(symbol);
 
-				if (symbol1) {
-					if (UST.count(first)) {
-						value += symbol1->value;
-						defined = symbol1->defined;
-					}
-					else if (symbol1->scope == LOCAL) {
-						value += symbol1->value;
+	if (entry->type == SymbolType::SECTION)
+		return Expression::Term(symbol, sign, symbol, 0);
 
-						if (symbol1->type == SymbolType::CONSTANT)
-							constant1 = true;
+	if (entry->type == SymbolType::LABEL && entry->defined)
+		return Expression::Term(symbol, sign, entry->section, entry->value);
 
-						first = symbol1->section;
-						defined = true;
-					}
-				}
-				else {
-					addSymbol(first, UNDEFINED, 0, GLOBAL, SymbolType::EXTERN, false);
-				}
+	return Expression::Term(symbol, sign, "", 0);
+}
 
-				if (symbol2) {
-					if (UST.count(second)) {
-						if (operation == "+")
-							value += symbol2->value;
-						else
-							value -= symbol2->value;
 
-						defined &= symbol2->defined;
-					}
-					else if (symbol2->scope == LOCAL) {
-						if (operation == "+")
-							value += symbol2->value;
-						else
-							value -= symbol2->value;
+int16_t Assembler::toWord(int64_t value) const {
+	if (value < INT16_MIN || value > UINT16_MAX)
+		throw AssemblingException(line, "Value " + to_string(value) + " doesn't fit into 16 bits!");
 
-						if (symbol2->type == SymbolType::CONSTANT)
-							constant2 = true;
+	return value;
+}
 
-						second = symbol2->section;
-					}
-				}
-				else {
-					addSymbol(second, UNDEFINED, 0, GLOBAL, SymbolType::EXTERN, false);
-					defined = false;
-				}
 
-				addSymbol(symbol, section->name, value, LOCAL, SymbolType::ALIAS, defined);
+void Assembler::makePCRelative(const Instruction* instruction, Instruction::Operand* operand) {
+	if (!operand) return;
 
-				UST.insert({ symbol, new UnresolvedSymbol(symbol, section) });
+	// plain symbol operands: memory direct access or jump target
+	bool jump = instruction->code >= JMP && instruction->code <= CALL;
 
-				if (UST.count(first))
-					UST[symbol]->dependencies = UST[first]->dependencies;
-				else if (!constant1)
-					UST[symbol]->dependencies.push_back({ first, "+" });
+	if (!(operand->type == MEMORY_SYMBOL || (jump && operand->type == IMMED_SYMBOL))) return;
 
-				if (UST.count(second))
-					UST[symbol]->dependencies = UST[second]->dependencies;
-				else if (!constant2)
-					UST[symbol]->dependencies.push_back({ second, operation });
+	const string& symbol = operand->value;
 
-				break;
-			}
-			default:
-				throw AssemblingException(line, "Invalid operand type in expression!");
-				break;
-			}
+	if (UST.count(symbol)) return;
 
-			break;
-		default:
-			throw AssemblingException(line, "Invalid operand type in expression!");
-			break;
-		}
+	if (symbolTable.count(symbol)) {
+		SymbolType type = symbolTable[symbol]->type;
 
-		break;
-	}
-	default:
-		throw AssemblingException(line, "Invalid expression!");
-		break;
+		if (type != SymbolType::LABEL && type != SymbolType::SECTION && type != SymbolType::EXTERN) return;
 	}
+
+	// same size as memory direct and immediate symbol operands
+	operand->displacement = symbol;
+	operand->value = "r7";
+	operand->type = PCRELATIVE;
+	operand->addressing = REG_IND_16;
 }
 
 
 void Assembler::generateInstructionCode(Instruction* instruction, Section* section) {
+	if (options.pic) {
+		makePCRelative(instruction, instruction->destination);
+		makePCRelative(instruction, instruction->source);
+	}
+
 	vector<uint8_t> bytes;
 
 	uint8_t byte = instruction->code << CODE_OFFSET | (instruction->operandSize - 1) << SIZE_OFFSET;
 	bytes.push_back(byte);
 
 	if (instruction->destination) {
-		const int16_t offset = locationCounter + BYTE * 2;
+		const uint32_t offset = locationCounter + BYTE * 2;
 
 		Instruction::Operand* destination = instruction->destination;
 
@@ -1293,7 +2002,7 @@ void Assembler::generateInstructionCode(Instruction* instruction, Section* secti
 			bytes.push_back(byte);
 
 			if (destination->type == IMMED_VALUE) {
-				int16_t value = strtol(destination->value.c_str(), NULL, 0);
+				int16_t value = toWord(strtol(destination->value.c_str(), NULL, 0));
 
 				uint8_t lower  =  value & 0x00FF;
 				uint8_t higher = (value & 0xFF00) >> 8;
@@ -1311,12 +2020,12 @@ void Assembler::generateInstructionCode(Instruction* instruction, Section* secti
 			}
 			else if (destination->type == IMMED_SYMBOL) {
 				string symbol = destination->value;
-				int16_t value = 0;
+				int32_t value = 0;
 
 				if (UST.count(symbol)) {
 					value = symbolTable[symbol]->value;
 
-					uint8_t lower  =  value & 0x00FF;
+					uint8_t lower  =  toWord(value) & 0x00FF;
 					uint8_t higher = (value & 0xFF00) >> 8;
 
 					if (instruction->operandSize == BYTE) {
@@ -1366,7 +2075,7 @@ void Assembler::generateInstructionCode(Instruction* instruction, Section* secti
 						addSymbol(symbol, UNDEFINED, 0, GLOBAL, SymbolType::EXTERN, false);
 					}
 
-					uint8_t lower  =  value & 0x00FF;
+					uint8_t lower  =  toWord(value) & 0x00FF;
 					uint8_t higher = (value & 0xFF00) >> 8;
 
 					if (instruction->operandSize == BYTE) {
@@ -1436,7 +2145,7 @@ void Assembler::generateInstructionCode(Instruction* instruction, Section* secti
 			bytes.push_back(byte);
 
 			if (destination->type == DISPL_VALUE) {
-				int16_t displacement = strtol(destination->displacement.c_str(), NULL, 0);
+				int16_t displacement = toWord(strtol(destination->displacement.c_str(), NULL, 0));
 
 				uint8_t lower  =  displacement & 0x00FF;
 				uint8_t higher = (displacement & 0xFF00) >> 8;
@@ -1450,12 +2159,12 @@ void Assembler::generateInstructionCode(Instruction* instruction, Section* secti
 			}
 			else if (destination->type == DISPL_SYMBOL) {
 				string symbol = destination->displacement;
-				int16_t value = 0;
+				int32_t value = 0;
 
 				if (UST.count(symbol)) {
 					value = symbolTable[symbol]->value;
 
-					uint8_t lower  =  value & 0x00FF;
+					uint8_t lower  =  toWord(value) & 0x00FF;
 					uint8_t higher = (value & 0xFF00) >> 8;
 
 					bytes.push_back(lower);
@@ -1489,7 +2198,7 @@ void Assembler::generateInstructionCode(Instruction* instruction, Section* secti
 						addSymbol(symbol, UNDEFINED, 0, GLOBAL, SymbolType::EXTERN, false);
 					}
 
-					uint8_t lower  =  value & 0x00FF;
+					uint8_t lower  =  toWord(value) & 0x00FF;
 					uint8_t higher = (value & 0xFF00) >> 8;
 
 					bytes.push_back(lower);
@@ -1501,13 +2210,13 @@ void Assembler::generateInstructionCode(Instruction* instruction, Section* secti
 			}
 			else if (destination->type == PCRELATIVE) {
 				string symbol = destination->displacement;
-				int16_t value = offset - (locationCounter + instruction->size);
+				int32_t value = (int32_t)offset - (int32_t)(locationCounter + instruction->size);
 
 				if (UST.count(symbol)) {
 					value += symbolTable[symbol]->value;
 					const auto& relocations = UST[symbol]->dependencies;
 
-					uint8_t lower  =  value & 0x00FF;
+					uint8_t lower  =  toWord(value) & 0x00FF;
 					uint8_t higher = (value & 0xFF00) >> 8;
 
 					bytes.push_back(lower);
@@ -1548,13 +2257,20 @@ void Assembler::generateInstructionCode(Instruction* instruction, Section* secti
 						addSymbol(symbol, UNDEFINED, 0, GLOBAL, SymbolType::EXTERN, false);
 					}
 
-					uint8_t lower  =  value & 0x00FF;
+					// the distance inside a section doesn't depend on where it is loaded
+					bool resolved = options.pic && symbolTable[symbol]->defined && symbolTable[symbol]->section == section->name;
+
+					if (resolved)
+						value += symbolTable[symbol]->value - offset;
+
+					uint8_t lower  =  toWord(value) & 0x00FF;
 					uint8_t higher = (value & 0xFF00) >> 8;
 
 					bytes.push_back(lower);
 					bytes.push_back(higher);
 
-					relocationTable.push_back(new Relocation(symbol, section->name, offset, R_386_PC16));
+					if (!resolved)
+						relocationTable.push_back(new Relocation(symbol, section->name, offset, R_386_PC16));
 				}
 			}
 			else
@@ -1566,7 +2282,7 @@ void Assembler::generateInstructionCode(Instruction* instruction, Section* secti
 			bytes.push_back(byte);
 
 			if (destination->type == MEMORY_VALUE) {
-				uint16_t address = strtol(destination->value.c_str(), NULL, 0);
+				uint16_t address = toWord(strtol(destination->value.c_str(), NULL, 0));
 
 				uint8_t lower  =  address & 0x00FF;
 				uint8_t higher = (address & 0xFF00) >> 8;
@@ -1576,12 +2292,12 @@ void Assembler::generateInstructionCode(Instruction* instruction, Section* secti
 			}
 			else if (destination->type == MEMORY_SYMBOL) {
 				string symbol = destination->value;
-				int16_t value = 0;
+				int32_t value = 0;
 
 				if (UST.count(symbol)) {
 					value = symbolTable[symbol]->value;
 
-					uint8_t lower  =  value & 0x00FF;
+					uint8_t lower  =  toWord(value) & 0x00FF;
 					uint8_t higher = (value & 0xFF00) >> 8;
 
 					bytes.push_back(lower);
@@ -1615,7 +2331,7 @@ void Assembler::generateInstructionCode(Instruction* instruction, Section* secti
 						addSymbol(symbol, UNDEFINED, 0, GLOBAL, SymbolType::EXTERN, false);
 					}
 
-					uint8_t lower  =  value & 0x00FF;
+					uint8_t lower  =  toWord(value) & 0x00FF;
 					uint8_t higher = (value & 0xFF00) >> 8;
 
 					bytes.push_back(lower);
@@ -1637,7 +2353,7 @@ void Assembler::generateInstructionCode(Instruction* instruction, Section* secti
 	}
 	
 	if (instruction->source) {
-		const int16_t offset = locationCounter + BYTE * 2 +
+		const uint32_t offset = locationCounter + BYTE * 2 +
 							  (instruction->destination ? instruction->destination->size : 0);
 
 		Instruction::Operand* source = instruction->source;
@@ -1649,7 +2365,7 @@ void Assembler::generateInstructionCode(Instruction* instruction, Section* secti
 			bytes.push_back(byte);
 
 			if (source->type == IMMED_VALUE) {
-				int16_t value = strtol(source->value.c_str(), NULL, 0);
+				int16_t value = toWord(strtol(source->value.c_str(), NULL, 0));
 
 				uint8_t lower  =  value & 0x00FF;
 				uint8_t higher = (value & 0xFF00) >> 8;
@@ -1667,12 +2383,12 @@ void Assembler::generateInstructionCode(Instruction* instruction, Section* secti
 			}
 			else if (source->type == IMMED_SYMBOL) {
 				string symbol = source->value;
-				int16_t value = 0;
+				int32_t value = 0;
 
 				if (UST.count(symbol)) {
 					value = symbolTable[symbol]->value;
 
-					uint8_t lower  =  value & 0x00FF;
+					uint8_t lower  =  toWord(value) & 0x00FF;
 					uint8_t higher = (value & 0xFF00) >> 8;
 
 					if (instruction->operandSize == BYTE) {
@@ -1722,7 +2438,7 @@ void Assembler::generateInstructionCode(Instruction* instruction, Section* secti
 						addSymbol(symbol, UNDEFINED, 0, GLOBAL, SymbolType::EXTERN, false);
 					}
 
-					uint8_t lower = value & 0x00FF;
+					uint8_t lower = toWord(value) & 0x00FF;
 					uint8_t higher = (value & 0xFF00) >> 8;
 
 					if (instruction->operandSize == BYTE) {
@@ -1795,7 +2511,7 @@ void Assembler::generateInstructionCode(Instruction* instruction, Section* secti
 			bytes.push_back(byte);
 
 			if (source->type == DISPL_VALUE) {
-				int16_t displacement = strtol(source->displacement.c_str(), NULL, 0);
+				int16_t displacement = toWord(strtol(source->displacement.c_str(), NULL, 0));
 
 				uint8_t lower  =  displacement & 0x00FF;
 				uint8_t higher = (displacement & 0xFF00) >> 8;
@@ -1809,12 +2525,12 @@ void Assembler::generateInstructionCode(Instruction* instruction, Section* secti
 			}
 			else if (source->type == DISPL_SYMBOL) {
 				string symbol = source->displacement;
-				int16_t value = 0;
+				int32_t value = 0;
 
 				if (UST.count(symbol)) {
 					value = symbolTable[symbol]->value;
 
-					uint8_t lower  =  value & 0x00FF;
+					uint8_t lower  =  toWord(value) & 0x00FF;
 					uint8_t higher = (value & 0xFF00) >> 8;
 
 					bytes.push_back(lower);
@@ -1848,7 +2564,7 @@ void Assembler::generateInstructionCode(Instruction* instruction, Section* secti
 						addSymbol(symbol, UNDEFINED, 0, GLOBAL, SymbolType::EXTERN, false);
 					}
 
-					uint8_t lower  =  value & 0x00FF;
+					uint8_t lower  =  toWord(value) & 0x00FF;
 					uint8_t higher = (value & 0xFF00) >> 8;
 
 					bytes.push_back(lower);
@@ -1860,13 +2576,13 @@ void Assembler::generateInstructionCode(Instruction* instruction, Section* secti
 			}
 			else if (source->type == PCRELATIVE) {
 				string symbol = source->displacement;
-				int16_t value = offset - (locationCounter + instruction->size);
+				int32_t value = (int32_t)offset - (int32_t)(locationCounter + instruction->size);
 
 				if (UST.count(symbol)) {
 					value += symbolTable[symbol]->value;
 					const auto& relocations = UST[symbol]->dependencies;
 
-					uint8_t lower  =  value & 0x00FF;
+					uint8_t lower  =  toWord(value) & 0x00FF;
 					uint8_t higher = (value & 0xFF00) >> 8;
 
 					bytes.push_back(lower);
@@ -1907,13 +2623,20 @@ void Assembler::generateInstructionCode(Instruction* instruction, Section* secti
 						addSymbol(symbol, UNDEFINED, 0, GLOBAL, SymbolType::EXTERN, false);
 					}
 
-					uint8_t lower  =  value & 0x00FF;
+					// the distance inside a section doesn't depend on where it is loaded
+					bool resolved = options.pic && symbolTable[symbol]->defined && symbolTable[symbol]->section == section->name;
+
+					if (resolved)
+						value += symbolTable[symbol]->value - offset;
+
+					uint8_t lower  =  toWord(value) & 0x00FF;
 					uint8_t higher = (value & 0xFF00) >> 8;
 
 					bytes.push_back(lower);
 					bytes.push_back(higher);
 
-					relocationTable.push_back(new Relocation(symbol, section->name, offset, R_386_PC16));
+					if (!resolved)
+						relocationTable.push_back(new Relocation(symbol, section->name, offset, R_386_PC16));
 				}
 			}
 			else
@@ -1925,7 +2648,7 @@ void Assembler::generateInstructionCode(Instruction* instruction, Section* secti
 			bytes.push_back(byte);
 
 			if (source->type == MEMORY_VALUE) {
-				uint16_t address = strtol(source->value.c_str(), NULL, 0);
+				uint16_t address = toWord(strtol(source->value.c_str(), NULL, 0));
 
 				uint8_t lower  =  address & 0x00FF;
 				uint8_t higher = (address & 0xFF00) >> 8;
@@ -1935,12 +2658,12 @@ void Assembler::generateInstructionCode(Instruction* instruction, Section* secti
 			}
 			else if (source->type == MEMORY_SYMBOL) {
 				string symbol = source->value;
-				int16_t value = 0;
+				int32_t value = 0;
 
 				if (UST.count(symbol)) {
 					value = symbolTable[symbol]->value;
 
-					uint8_t lower  =  value & 0x00FF;
+					uint8_t lower  =  toWord(value) & 0x00FF;
 					uint8_t higher = (value & 0xFF00) >> 8;
 
 					bytes.push_back(lower);
@@ -1974,7 +2697,7 @@ void Assembler::generateInstructionCode(Instruction* instruction, Section* secti
 						addSymbol(symbol, UNDEFINED, 0, GLOBAL, SymbolType::EXTERN, false);
 					}
 
-					uint8_t lower  =  value & 0x00FF;
+					uint8_t lower  =  toWord(value) & 0x00FF;
 					uint8_t higher = (value & 0xFF00) >> 8;
 
 					bytes.push_back(lower);
@@ -2,46 +2,200 @@
 #define _ASSEMBLER_H_
 
 #include <fstream>
+#include <istream>
 #include <queue>
 #include <vector>
 #include <string>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <atomic>
 #include <utility>
 #include <unordered_map>
 #include <unordered_set>
 
+#include "exceptions.h"
 #include "usymbol.h"
+#include "merge.h"
+#include "macro.h"
+#include "ringbuffer.h"
 #include "types.h"
 #include "symbol.h"
 #include "section.h"
 #include "instruction.h"
 #include "relocation.h"
+#include "expression.h"
+#include "object.h"
+#include "spill.h"
 
 class Assembler {
 public:
+	struct Options {
+		Options() : listing(true), hashIndex(false), pic(false), compress(false), check(false), stream(false), threads(1), errorLimit(1),
+			dependencies(false), ifChanged(false), format(OBJECT) {}
+
+		// write the textual listing (.txt) next to the output file
+		bool listing;
+
+		// emit the hash index over defined global symbols
+		bool hashIndex;
+
+		// encode symbol references PC relative (through r7) where possible
+		bool pic;
+
+		// LZ compress contents of data sections in the object file
+		bool compress;
+
+		// only report errors: the passes run, but nothing is written
+		bool check;
+
+		// read the source a chunk at a time in both passes instead of keeping all of it
+		// in memory, instructions are decoded again by the second pass; object contents,
+		// relocations and line entries go to temporary files as they are produced, so only
+		// the symbols grow with the input (memory images are still built whole)
+		bool stream;
+
+		// threads lexing pieces of a large main file, 0 for one per core; the
+		// whole file is read first, so streaming always lexes on one thread
+		uint32_t threads;
+
+		// errors reported before assembling stops, 0 for no limit; with more than one
+		// a bad statement is reported and skipped, and the rest is still checked
+		uint32_t errorLimit;
+
+		// write a make rule listing the source and .incbin files of the output,
+		// to dependencyFile or next to the output file (.d)
+		bool dependencies;
+		std::string dependencyFile;
+
+		// stamp the object with hashes of its inputs, and assemble nothing
+		// while the stamp of an existing object still matches them
+		bool ifChanged;
+
+		OutputFormat format;
+
+		// memory image addresses of sections, by name
+		std::unordered_map<std::string, uint16_t> sectionStarts;
+	};
+
+	Assembler() : inputEnded(true), stopReader(false), chunkStart(0), program("", false), entity(nullptr) {}
+	Assembler(const Options& t_options) :
+		options(t_options), inputEnded(true), stopReader(false), chunkStart(0), program("", false), entity(nullptr) {}
+
 	~Assembler();
 
 	void assemble(const std::string& input, std::string& output);
 private:
+	// tokenized statements of a source file (up to .end) and their line numbers
+	struct SourceFile {
+		std::vector<std::vector<std::string>> statements;
+		std::vector<uint32_t> lines;
+	};
+
+	// statements of the main file tokenized by the reader thread
+	struct Chunk {
+		SourceFile source;
+		bool last;
+	};
+
+	struct CachedFile {
+		int64_t modified;
+		uint64_t size;
+
+		std::shared_ptr<const SourceFile> source;
+	};
+
 	void readAssembly(const std::string& file);
 
+	// reads up to limit statements, true once the end of the file (or .end) is reached
+	static bool tokenize(std::istream& input, SourceFile& source, uint32_t& number, size_t limit);
+
+	// puts the first chunk of the pass in program, streaming starts reading the main file over
+	void rewindInput();
+
+	// adds the next chunk of the main file to program, false at the end of the file;
+	// streaming replaces the statements walked so far, only those of macros stay
+	bool readChunk();
+
+	// reader thread: tokenizes the main file a chunk at a time into chunks
+	void startReader();
+	void readInput();
+
+	// reader thread: splits the whole main file into pieces tokenized in parallel
+	void readPieces(size_t threads);
+
+	// false if the reader was stopped before chunk was taken, sleeps while chunks is full
+	bool pushChunk(Chunk* chunk);
+
+	// next chunk of the reader, sleeps while chunks is empty
+	Chunk* popChunk();
+
+	// tokenized file, reused across assemblies while its modification time and size stay the same
+	static std::shared_ptr<const SourceFile> loadInclude(const std::string& path);
+
+	// appends statements of a file to assembly and the open block, expanding .include
+	// and collecting .macro/.rept blocks
+	void addStatements(const SourceFile& source, uint32_t file, std::vector<std::string>& includes);
+
+	void addStatement(const std::vector<std::string>& tokens, uint32_t number, uint32_t file);
+
+	// path relative to the directory of a source file
+	std::string resolvePath(const std::string& path, uint32_t file) const;
+
 	void firstPass();
+	// a label alone on its line carries over to the next statement through labelDefined
+	void firstPassStatement(size_t statement, const std::vector<std::string>& tokens, Section*& currentSection, bool& labelDefined);
 
 	void resolveSymbols();
-	bool hasCycle(const std::unordered_map<std::string, UnresolvedSymbol*>& UST);
+
+	// folds the known values of the dependencies of an alias into it, aliases it depends on first
+	void resolveSymbol(const std::string& name, std::unordered_set<std::string>& resolved);
+	// closing is set to the alias whose dependency closes the cycle
+	bool hasCycle(const std::unordered_map<std::string, UnresolvedSymbol*>& UST, std::string& closing);
 
 	bool cycle(const std::string& symbol,
 			   std::unordered_set<std::string>& visited,
-			   std::unordered_set<std::string>& recursionStack);
+			   std::unordered_set<std::string>& recursionStack,
+			   std::string& closing);
+
+	// merge (M) sections
+	void addToEntity(size_t statement, const std::string& directive, std::queue<std::string> values);
+	void addLabelToEntity(const std::string& label);
+	void closeEntity(Section* section);
 
 	void secondPass();
+	void secondPassStatement(size_t statement, const std::vector<std::string>& tokens, Section*& currentSection);
+
+	// streaming: hands what the second pass finished of the section over to the object
+	// writer (drops it when only checking), all of it once the pass leaves the section
+	void spill(Section* section, bool finished);
+
+	std::unique_ptr<ObjectWriter> createWriter(const std::string& file) const;
 
 	void writeELF(const std::string& file);
 
+	void writeImage(const std::string& file);
+
 	void writeText(const std::string& file);
 
+	// appends a line table row of the listing
+	void formatLine(std::string& out, const Section* section, const SourceLine& entry) const;
+
+	void writeDependencies(const std::string& file, const std::string& target) const;
+
+	// main file, included and .incbin files, in the order they were first read
+	std::vector<std::string> inputFiles() const;
+
+	// hash of the options that change the outputs
+	uint64_t optionsHash(const std::string& output) const;
+
+	// object stamped by an earlier run with the same options and inputs, other outputs present
+	bool upToDate(const std::string& input, const std::string& output) const;
+
 	void addSymbol(const std::string& name,
 				   const std::string& section,
-				   int16_t value,
+				   int32_t value,
 				   ScopeType scope,
 				   SymbolType type,
 				   bool defined);
@@ -50,17 +204,94 @@ private:
 
 	void evaluate(const std::string& directive, const std::string& expression, Section* section);
 
+	// writes the literal values of a .byte/.word statement starting at first in one go,
+	// returns how many were written (stops at anything evaluate has to handle)
+	size_t writeLiterals(const std::string& directive, const std::vector<std::string>& values, size_t first, Section* section);
+
 	void evaluateEQU(const std::string& symbol, const std::string& expression, Section* section);
 
+	// value of an expression with the symbols known so far
+	Expression::Value fold(const Expression& expression);
+
+	// value of a symbol in an expression, what only the linker knows is left in terms
+	Expression::Value reference(const std::string& name);
+
+	// relocation target with its place in this file, when known
+	Expression::Term term(const std::string& symbol, int sign) const;
+
+	// sizes the part of the file a .incbin statement embeds
+	void addBinary(size_t statement, std::queue<std::string>& arguments);
+
+	void makePCRelative(const Instruction* instruction, Instruction::Operand* operand);
+
 	void generateInstructionCode(Instruction* instruction, Section* section);
+
+	// value of a 16-bit field of the encoding, diagnoses overflow
+	int16_t toWord(int64_t value) const;
+
+	// reports the error of a statement and marks it to be skipped, throws once the error limit is reached
+	void recover(const AssemblingException& error, size_t statement);
+
+	// prints the kept errors in program order
+	void reportErrors();
+
+	// warns about absolute relocations added since the given one (-fpic)
+	void reportAbsolute(size_t first) const;
+
+	Options options;
 	
 	uint32_t line;
-	uint16_t locationCounter;
+	uint32_t locationCounter;
+
+	// source file of the current statement, index into sourceFiles
+	uint32_t currentFile;
 
+	// the current statement is an expansion of a .rept or macro block
+	bool expanded;
+
+	// decoded by the first pass for the second, except for streamed and expanded statements
 	std::queue<Instruction*> instructions;
 
 	std::vector<std::vector<std::string>> assembly;
 
+	// source line number of each entry in assembly
+	std::vector<uint32_t> lineNumbers;
+
+	// source file of each entry in assembly, index into sourceFiles
+	std::vector<uint32_t> fileIndices;
+
+	// main source file, read by the reader thread
+	std::ifstream input;
+	bool inputEnded;
+
+	// tokenized ahead of the pass walking them
+	RingBuffer<Chunk*, 5> chunks;
+
+	std::thread reader;
+	std::atomic<bool> stopReader;
+
+	// the side finding chunks full or empty waits here for the other one
+	std::mutex chunkMutex;
+	std::condition_variable chunkChanged;
+
+	// first item of program added by the last chunk
+	size_t chunkStart;
+
+	// statements of the program in order, macro invocations and .rept blocks
+	// refer to blocks whose statements are stored once in assembly
+	Block program;
+
+	// blocks being read, innermost last
+	std::vector<Block*> openBlocks;
+
+	std::unordered_map<std::string, Block*> macros;
+
+	// all macro and .rept blocks
+	std::vector<Block*> blocks;
+
+	// source files, indexed by SourceLine::file
+	std::vector<std::string> sourceFiles;
+
 	std::unordered_map<std::string, Symbol*>  symbolTable;
 	std::unordered_map<std::string, Section*> sectionTable;
 
@@ -68,6 +299,45 @@ private:
 	std::unordered_map<std::string, UnresolvedSymbol*> UST;
 
 	std::vector<Relocation*> relocationTable;
+
+	// streamed object, created before the second pass, and the listing rows
+	// of the relocations and line entries handed over to it
+	std::unique_ptr<ObjectWriter> objectWriter;
+	std::unique_ptr<SpillFile> relocationRows;
+	std::unique_ptr<SpillFile> lineRows;
+
+	// entity of a merge section being collected, nullptr between entities
+	MergeEntity* entity;
+
+	// section name -> entity contents -> offset of the kept copy
+	std::unordered_map<std::string, std::unordered_map<std::string, uint32_t>> mergeTables;
+
+	// statements (StatementCursor::index) dropped as duplicates, skipped by the second pass
+	std::unordered_set<size_t> merged;
+
+	// errors kept by recover with their statement (StatementCursor::index)
+	std::vector<std::pair<size_t, std::string>> diagnostics;
+
+	// statements whose errors were kept, skipped by the second pass
+	std::unordered_set<size_t> failed;
+
+	// part of a file embedded by .incbin
+	struct Binary {
+		std::string path;
+
+		uint64_t offset;
+		uint32_t length;
+	};
+
+	// .incbin statement -> file part, sized by the first pass
+	std::unordered_map<size_t, Binary> binaries;
+
+	// files embedded by .incbin, each once
+	std::vector<std::string> binaryFiles;
+
+	// included files by path, shared by all assemblies of the process
+	static std::unordered_map<std::string, CachedFile> includeCache;
+	static std::mutex includeMutex;
 };
 
 #endif
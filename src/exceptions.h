@@ -6,14 +6,42 @@
 
 class AssemblingException : public std::exception {
 public:
-	AssemblingException(const std::string& error) {
+	AssemblingException(const std::string& t_error) : line(0), error(t_error) {
 		message = "ASSEMBLING ERROR: " + error;
 	}
 
-	AssemblingException(uint32_t line, const std::string& error) {
+	AssemblingException(uint32_t t_line, const std::string& t_error) : line(t_line), error(t_error) {
 		message = "ASSEMBLING ERROR(line " + std::to_string(line) + "): " + error;
 	}
 
+	AssemblingException(const std::string& t_file, uint32_t t_line, const std::string& t_error) :
+		file(t_file), line(t_line), error(t_error) {
+		message = "ASSEMBLING ERROR(" + file + ":" + std::to_string(line) + "): " + error;
+	}
+
+	// the error at its line of source file, if it has a line but no file yet
+	AssemblingException in(const std::string& source) const {
+		return line && file.empty() ? AssemblingException(source, line, error) : *this;
+	}
+
+	const char* what() const noexcept override {
+		return message.c_str();
+	}
+private:
+	std::string file;
+	uint32_t line;
+
+	std::string error;
+	std::string message;
+};
+
+
+class ObjectException : public std::exception {
+public:
+	ObjectException(const std::string& error) {
+		message = "OBJECT FILE ERROR: " + error;
+	}
+
 	const char* what() const noexcept override {
 		return message.c_str();
 	}
@@ -0,0 +1,272 @@
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <cstring>
+#include <cstdlib>
+#include <cctype>
+#include <cstdint>
+
+#include "expression.h"
+#include "exceptions.h"
+#include "utils.h"
+
+using namespace std;
+
+
+void Expression::Value::add(const Term& term) {
+	for (size_t i = 0; i < terms.size(); i++) {
+		const Term& other = terms[i];
+
+		if (other.sign == term.sign) continue;
+		if (other.symbol != term.symbol && (term.section.empty() || other.section != term.section)) continue;
+
+		constant += term.sign * term.offset + other.sign * other.offset;
+		terms.erase(terms.begin() + i);
+		return;
+	}
+
+	terms.push_back(term);
+}
+
+
+void Expression::Value::add(const Value& value, int sign) {
+	constant = (uint32_t)constant + (uint32_t)sign * (uint32_t)value.constant;
+
+	for (Term term : value.terms) {
+		term.sign *= sign;
+		add(term);
+	}
+}
+
+
+Expression::Expression(const string& t_text, uint32_t t_line) : text(t_text), line(t_line), position(0) {
+	next();
+
+	binary(1);
+
+	if (!token.empty())
+		throw AssemblingException(line, "Unexpected \"" + token + "\" in expression \"" + text + "\"!");
+}
+
+
+Expression::Value Expression::evaluate(const Resolver& resolve) const {
+	return evaluate(nodes.size() - 1, resolve);
+}
+
+
+size_t Expression::length(const vector<string>& tokens, size_t first) {
+	int depth = 0;
+	size_t i = first;
+
+	while (true) {
+		const string& token = tokens[i];
+
+		for (char c : token) {
+			if (c == '(') ++depth;
+			else if (c == ')') --depth;
+		}
+
+		if (++i == tokens.size()) break;
+
+		const string& following = tokens[i];
+		int64_t literal;
+
+		bool open = depth > 0 || strchr("+-*/%<>&|^~(", token.back());
+		bool joined = strchr("+-*/%<>&|^)", following[0]) && !Utils::parseLiteral(following, literal);
+
+		if (!open && !joined) break;
+	}
+
+	return i - first;
+}
+
+
+void Expression::next() {
+	while (position < text.size() && isspace((unsigned char)text[position])) ++position;
+
+	token.clear();
+
+	if (position == text.size()) return;
+
+	size_t start = position;
+	char c = text[position];
+
+	if (isalnum((unsigned char)c) || c == '_') {
+		while (position < text.size() && (isalnum((unsigned char)text[position]) || text[position] == '_')) ++position;
+	}
+	else if ((c == '<' || c == '>') && position + 1 < text.size() && text[position + 1] == c) {
+		position += 2;
+	}
+	else if (strchr("+-*/%&|^~()", c)) {
+		++position;
+	}
+	else
+		throw AssemblingException(line, string("Invalid character '") + c + "' in expression \"" + text + "\"!");
+
+	token = text.substr(start, position - start);
+}
+
+
+int Expression::precedence(const string& token) {
+	if (token == "|") return 1;
+	if (token == "^") return 2;
+	if (token == "&") return 3;
+	if (token == "<<" || token == ">>") return 4;
+	if (token == "+" || token == "-") return 5;
+	if (token == "*" || token == "/" || token == "%") return 6;
+
+	return 0;
+}
+
+
+size_t Expression::binary(int minimum) {
+	const size_t start = nodes.size();
+
+	size_t left = unary();
+
+	for (int current = precedence(token); current >= minimum; current = precedence(token)) {
+		string operation = token;
+		next();
+
+		size_t right = binary(current + 1);
+
+		// constant subtrees are replaced by their value
+		if (nodes[left].kind == Node::NUMBER && nodes[right].kind == Node::NUMBER) {
+			int32_t value = apply(operation, nodes[left].value, nodes[right].value).constant;
+
+			nodes.resize(start);
+			nodes.push_back({ Node::NUMBER, "", value, 0, 0 });
+		}
+		else
+			nodes.push_back({ Node::BINARY, operation, 0, left, right });
+
+		left = nodes.size() - 1;
+	}
+
+	return left;
+}
+
+
+size_t Expression::unary() {
+	if (token.empty())
+		throw AssemblingException(line, "Incomplete expression \"" + text + "\"!");
+
+	string current = token;
+	next();
+
+	if (current == "+") return unary();
+
+	if (current == "-" || current == "~") {
+		const size_t start = nodes.size();
+
+		size_t operand = unary();
+
+		if (nodes[operand].kind == Node::NUMBER) {
+			int32_t value = nodes[operand].value;
+
+			nodes.resize(start);
+			nodes.push_back({ Node::NUMBER, "", current == "-" ? (int32_t)(0 - (uint32_t)value) : ~value, 0, 0 });
+		}
+		else
+			nodes.push_back({ Node::UNARY, current, 0, operand, 0 });
+
+		return nodes.size() - 1;
+	}
+
+	if (current == "(") {
+		size_t node = binary(1);
+
+		if (token != ")")
+			throw AssemblingException(line, "Missing \")\" in expression \"" + text + "\"!");
+
+		next();
+		return node;
+	}
+
+	if (isdigit((unsigned char)current[0])) {
+		char* end = nullptr;
+		unsigned long number = strtoul(current.c_str(), &end, 0);
+
+		if (*end || number > UINT32_MAX)
+			throw AssemblingException(line, "Invalid number \"" + current + "\" in expression!");
+
+		nodes.push_back({ Node::NUMBER, "", (int32_t)number, 0, 0 });
+		return nodes.size() - 1;
+	}
+
+	if (isalpha((unsigned char)current[0]) || current[0] == '_') {
+		if (find(names.begin(), names.end(), current) == names.end())
+			names.push_back(current);
+
+		nodes.push_back({ Node::SYMBOL, current, 0, 0, 0 });
+		return nodes.size() - 1;
+	}
+
+	throw AssemblingException(line, "Unexpected \"" + current + "\" in expression \"" + text + "\"!");
+}
+
+
+Expression::Value Expression::evaluate(size_t node, const Resolver& resolve) const {
+	const Node& current = nodes[node];
+
+	switch (current.kind) {
+	case Node::NUMBER:
+		return current.value;
+	case Node::SYMBOL:
+		return resolve(current.text);
+	case Node::UNARY: {
+		Value operand = evaluate(current.left, resolve);
+
+		if (current.text == "~") {
+			if (!operand.terms.empty())
+				throw AssemblingException(line, "Operand of \"~\" must be a constant in expression \"" + text + "\"!");
+
+			operand.constant = ~operand.constant;
+			return operand;
+		}
+
+		Value value;
+		value.add(operand, -1);
+		return value;
+	}
+	default:
+		return apply(current.text, evaluate(current.left, resolve), evaluate(current.right, resolve));
+	}
+}
+
+
+Expression::Value Expression::apply(const string& operation, const Value& left, const Value& right) const {
+	Value result = left;
+
+	if (operation == "+" || operation == "-") {
+		result.add(right, operation == "+" ? 1 : -1);
+		return result;
+	}
+
+	// everything else only folds constants, the linker can't finish it
+	if (!left.terms.empty() || !right.terms.empty())
+		throw AssemblingException(line, "Operands of \"" + operation + "\" must be constants in expression \"" + text + "\"!");
+
+	uint32_t a = left.constant;
+	uint32_t b = right.constant;
+
+	if ((operation == "/" || operation == "%") && b == 0)
+		throw AssemblingException(line, "Division by zero in expression \"" + text + "\"!");
+
+	if ((operation == "<<" || operation == ">>") && b > 31)
+		throw AssemblingException(line, "Invalid shift by " + to_string(right.constant) + " in expression \"" + text + "\"!");
+
+	// INT32_MIN / -1 wraps like the other operations instead of trapping
+	if ((operation == "/" || operation == "%") && right.constant == -1)
+		result.constant = operation == "/" ? 0 - a : 0;
+	else if (operation == "*")	result.constant = a * b;
+	else if (operation == "/")	result.constant = left.constant / right.constant;
+	else if (operation == "%")	result.constant = left.constant % right.constant;
+	else if (operation == "<<")	result.constant = a << b;
+	else if (operation == ">>")	result.constant = left.constant >> b;
+	else if (operation == "&")	result.constant = a & b;
+	else if (operation == "^")	result.constant = a ^ b;
+	else if (operation == "|")	result.constant = a | b;
+
+	return result;
+}
\ No newline at end of file
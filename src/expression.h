@@ -0,0 +1,101 @@
+#ifndef _EXPRESSION_H_
+#define _EXPRESSION_H_
+
+#include <string>
+#include <vector>
+#include <functional>
+
+// Constant expression of .equ, .byte and .word: C operators and precedence
+// (| ^ & << >> + - * / % and unary - ~ +) with parentheses. Constant subtrees
+// are folded while parsing; evaluation folds the rest into a constant and
+// relocatable terms, the symbol +/- constant form the linker can finish.
+class Expression {
+public:
+	// symbol the linker adds (sign 1) or subtracts (sign -1)
+	struct Term {
+		Term(const std::string& t_symbol, int t_sign, const std::string& t_section, int32_t t_offset) :
+			symbol(t_symbol), sign(t_sign), section(t_section), offset(t_offset) {}
+
+		std::string symbol;
+		int sign;
+
+		// for symbols placed in this file, so differences in one section fold to constants
+		std::string section;
+		int32_t offset;
+	};
+
+	struct Value {
+		Value() : constant(0) {}
+		Value(int32_t t_constant) : constant(t_constant) {}
+
+		// adds a term, cancelling it against an opposite one of the same symbol or section
+		void add(const Term& term);
+
+		// adds (sign 1) or subtracts (sign -1) a value
+		void add(const Value& value, int sign);
+
+		int32_t constant;
+		std::vector<Term> terms;
+	};
+
+	typedef std::function<Value(const std::string&)> Resolver;
+
+	// parses the text, throws AssemblingException on syntax errors
+	Expression(const std::string& t_text, uint32_t t_line);
+
+	// looks up the symbols through resolve, throws AssemblingException for
+	// operations on relocatable values the linker can't finish
+	Value evaluate(const Resolver& resolve) const;
+
+	// symbols the expression refers to, in order of appearance
+	const std::vector<std::string>& symbols() const {
+		return names;
+	}
+
+	// number of tokens of a .byte/.word statement (split at blanks and commas) that form the value
+	// starting at first: the value goes on after an operator or open parenthesis and before a binary
+	// operator, a negative literal ("1, -2") starts a new one
+	static size_t length(const std::vector<std::string>& tokens, size_t first);
+private:
+	struct Node {
+		enum Kind : uint8_t { NUMBER, SYMBOL, UNARY, BINARY };
+
+		Kind kind;
+
+		// operator or symbol name
+		std::string text;
+		int32_t value;
+
+		// operands, indices into nodes
+		size_t left;
+		size_t right;
+	};
+
+	// reads the next token, empty at the end of the text
+	void next();
+
+	// binary operators binding at least as tight as minimum
+	size_t binary(int minimum);
+
+	size_t unary();
+
+	Value evaluate(size_t node, const Resolver& resolve) const;
+
+	Value apply(const std::string& operation, const Value& left, const Value& right) const;
+
+	// 0 for anything that isn't a binary operator
+	static int precedence(const std::string& token);
+
+	std::string text;
+	uint32_t line;
+
+	// root is the last one
+	std::vector<Node> nodes;
+	std::vector<std::string> names;
+
+	// parsing state
+	size_t position;
+	std::string token;
+};
+
+#endif
\ No newline at end of file
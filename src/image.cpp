@@ -0,0 +1,165 @@
+#include <string>
+#include <vector>
+#include <cstring>
+#include <algorithm>
+#include <unordered_map>
+
+#include "exceptions.h"
+#include "types.h"
+#include "utils.h"
+#include "symbol.h"
+#include "section.h"
+#include "relocation.h"
+#include "image.h"
+
+using namespace std;
+
+
+ImageWriter::ImageWriter(const unordered_map<string, Symbol*>& symbolTable,
+						 const unordered_map<string, Section*>& sectionTable,
+						 const vector<Relocation*>& relocationTable) :
+	symbols(symbolTable), relocations(relocationTable) {
+	// only allocatable sections are loaded
+	for (const auto& entry : sectionTable)
+		if (entry.second->flags[A] == '1') sections.push_back(entry.second);
+
+	sort(sections.begin(), sections.end(), [](const Section* a, const Section* b) {
+		return a->sectionTableEntry < b->sectionTableEntry;
+	});
+}
+
+
+void ImageWriter::write(string& out, OutputFormat format) {
+	memory.assign(IMAGE_SIZE, 0);
+	addresses.clear();
+
+	place();
+
+	relocate();
+
+	if (format == BINARY)
+		out.append(reinterpret_cast<const char*>(memory.data()), memory.size());
+	else
+		writeHex(out);
+}
+
+
+void ImageWriter::place() {
+	for (const auto& entry : starts)
+		if (find_if(sections.begin(), sections.end(), [&](const Section* section) { return section->name == entry.first; }) == sections.end())
+			throw AssemblingException("Start address given for unknown or non-allocatable section " + entry.first + "!");
+
+	uint32_t address = 0;
+
+	// placed ranges, for overlap checks
+	vector<pair<uint32_t, const Section*>> placed;
+
+	for (const Section* section : sections) {
+		auto start = starts.find(section->name);
+		if (start != starts.end()) address = start->second;
+
+		if (address + section->size > IMAGE_SIZE)
+			throw AssemblingException("Section " + section->name + " doesn't fit into memory!");
+
+		for (const auto& other : placed)
+			if (address < other.first + other.second->size && other.first < address + section->size)
+				throw AssemblingException("Sections " + other.second->name + " and " + section->name + " overlap!");
+
+		addresses[section->name] = address;
+		placed.push_back({ address, section });
+
+		if (!section->bytes.empty()) memcpy(memory.data() + address, section->bytes.data(), section->bytes.size());
+
+		address += section->size;
+	}
+}
+
+
+void ImageWriter::relocate() {
+	for (const Relocation* relocation : relocations) {
+		auto target = addresses.find(relocation->section);
+		if (target == addresses.end()) continue;
+
+		auto entry = symbols.find(relocation->symbol);
+		if (entry == symbols.end())
+			throw AssemblingException("Unknown symbol " + relocation->symbol + " in relocation!");
+
+		const Symbol* symbol = entry->second;
+		int32_t value;
+
+		if (symbol->type == SymbolType::CONSTANT) {
+			value = symbol->value;
+		}
+		else if (symbol->defined && (symbol->type == SymbolType::LABEL || symbol->type == SymbolType::SECTION)) {
+			auto base = addresses.find(symbol->section);
+
+			if (base == addresses.end())
+				throw AssemblingException("Symbol " + symbol->name + " is not in a loaded section!");
+
+			value = base->second + symbol->value;
+		}
+		else
+			throw AssemblingException("Unresolved symbol " + symbol->name + " can't be placed into memory image!");
+
+		uint32_t position = target->second + relocation->offset;
+
+		switch (relocation->type) {
+		case R_386_8:
+		case R_386_SUB_8:
+			if (relocation->type == R_386_SUB_8) value = -value;
+
+			memory[position] += value;
+			break;
+		case R_386_16:
+		case R_386_SUB_16:
+		case R_386_PC16:
+		case R_386_SUB_PC16: {
+			if (relocation->type == R_386_SUB_16 || relocation->type == R_386_SUB_PC16) value = -value;
+
+			// the addend of PC relative relocations already holds the distance
+			// from the field to the end of the instruction
+			if (relocation->type == R_386_PC16 || relocation->type == R_386_SUB_PC16) value -= position;
+
+			uint16_t word = (memory[position] | memory[position + 1] << 8) + value;
+
+			memory[position]     = word & 0x00FF;
+			memory[position + 1] = (word & 0xFF00) >> 8;
+			break;
+		}
+		}
+	}
+}
+
+
+void ImageWriter::writeHex(string& out) const {
+	const uint8_t bytesPerRecord = 16;
+
+	for (const Section* section : sections) {
+		uint32_t start = addresses.at(section->name);
+
+		for (uint32_t offset = 0; offset < section->size; offset += bytesPerRecord) {
+			uint32_t address = start + offset;
+			uint8_t count = min<uint32_t>(bytesPerRecord, section->size - offset);
+
+			// data record: :LLAAAA00DD..CC
+			uint8_t checksum = count + (address >> 8) + address;
+
+			out += ':';
+			Utils::appendHex(out, count);
+			Utils::appendHex(out, address >> 8);
+			Utils::appendHex(out, address);
+			Utils::appendHex(out, 0x00);
+
+			for (uint8_t i = 0; i < count; i++) {
+				Utils::appendHex(out, memory[address + i]);
+				checksum += memory[address + i];
+			}
+
+			Utils::appendHex(out, -checksum);
+			out += '\n';
+		}
+	}
+
+	// end of file record
+	out += ":00000001FF\n";
+}
\ No newline at end of file
@@ -0,0 +1,59 @@
+#ifndef _IMAGE_H_
+#define _IMAGE_H_
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+
+#include "types.h"
+#include "symbol.h"
+#include "section.h"
+#include "relocation.h"
+
+// Memory image of a fully resolved program
+//
+// Allocatable sections are placed at their start addresses (sections without
+// one follow the previous section, starting from 0) and relocations are
+// applied at assembly time, so the image can be loaded with a single copy.
+// BINARY is the raw 64 KB address space, IHEX lists the placed sections as
+// Intel HEX data records.
+
+// size of the target address space
+constexpr uint32_t IMAGE_SIZE = 0x10000;
+
+
+class ImageWriter {
+public:
+	ImageWriter(const std::unordered_map<std::string, Symbol*>& symbolTable,
+				const std::unordered_map<std::string, Section*>& sectionTable,
+				const std::vector<Relocation*>& relocationTable);
+
+	// places the section at the given address instead of after the previous one
+	void setSectionStart(const std::string& section, uint16_t address) {
+		starts[section] = address;
+	}
+
+	// writes the image in the given format (BINARY or IHEX) into the output buffer
+	void write(std::string& out, OutputFormat format);
+private:
+	void place();
+
+	void relocate();
+
+	void writeHex(std::string& out) const;
+
+	const std::unordered_map<std::string, Symbol*>& symbols;
+
+	std::vector<const Section*> sections;
+
+	const std::vector<Relocation*>& relocations;
+
+	std::unordered_map<std::string, uint16_t> starts;
+
+	// address of each placed section
+	std::unordered_map<std::string, uint32_t> addresses;
+
+	std::vector<uint8_t> memory;
+};
+
+#endif
\ No newline at end of file
@@ -1,5 +1,8 @@
 #include <queue>
+#include <memory>
 #include <regex>
+#include <string>
+#include <cstdio>
 #include <unordered_map>
 
 #include "exceptions.h"
@@ -11,9 +14,25 @@
 using namespace std;
 
 
+// displacement given by a symbol rather than a number
+static const regex symbolName("^[a-zA-Z_]\\w*$");
+
+
 uint8_t Instruction::operands[] = { 0, 0, 2, 1, 2, 2, 2, 2, 2, 2, 1, 2, 2, 2, 2, 2, 2, 1, 1, 1, 1, 1, 1, 1, 0, 0 };
 
 
+const char* Instruction::mnemonics[] = {
+	"",
+	"halt", "xchg", "int",  "mov",
+	"add",  "sub",  "mul",  "div", "cmp",
+	"not",  "and",  "or",   "xor", "test",
+	"shl",  "shr",
+	"push", "pop",
+	"jmp",  "jeq",  "jne",  "jgt",
+	"call", "ret",  "iret"
+};
+
+
 unordered_map<string, pair<InstructionCode, uint8_t>> Instruction::instructionMap = {
 	{ "halt", { HALT, 0 } },
 	{ "xchg", { XCHG, 2 } },
@@ -77,7 +96,7 @@ Instruction::~Instruction() {
 }
 
 
-Instruction* Instruction::extract(queue<string>& tokens, smatch& matches, uint16_t line) {
+Instruction* Instruction::extract(queue<string>& tokens, smatch& matches, uint32_t line) {
 	string token;
 	string mnemonic = matches[1];
 	string suffix   = matches[2].matched ? matches[2].str() : "w";
@@ -93,8 +112,9 @@ Instruction* Instruction::extract(queue<string>& tokens, smatch& matches, uint16
 		operandSize = WORD;
 
 	size_t size = BYTE;
-	Operand* destination = nullptr;
-	Operand* source = nullptr;
+	// freed when a later operand is rejected
+	unique_ptr<Operand> destination;
+	unique_ptr<Operand> source;
 
 	if (operands >= 1) {
 		if (tokens.empty())
@@ -108,9 +128,9 @@ Instruction* Instruction::extract(queue<string>& tokens, smatch& matches, uint16
 		switch (tokenType) {
 		case SYMBOL:
 			if (Utils::isJump(mnemonic))
-				destination = new Operand(matches[0], "", WORD + BYTE, IMMED_SYMBOL, IMMED);
+				destination.reset(new Operand(matches[0], "", WORD + BYTE, IMMED_SYMBOL, IMMED));
 			else
-				destination = new Operand(matches[0], "", WORD + BYTE, MEMORY_SYMBOL, MEMORY);
+				destination.reset(new Operand(matches[0], "", WORD + BYTE, MEMORY_SYMBOL, MEMORY));
 			size += WORD + BYTE;
 
 			break;
@@ -118,12 +138,12 @@ Instruction* Instruction::extract(queue<string>& tokens, smatch& matches, uint16
 			if (mnemonic != "int" && mnemonic != "push")
 				throw AssemblingException(line, "Immediate value is not allowed as a destination operand!");
 
-			destination = new Operand(matches[1], "", operandSize + BYTE, IMMED_SYMBOL, IMMED);
+			destination.reset(new Operand(matches[1], "", operandSize + BYTE, IMMED_SYMBOL, IMMED));
 			size += operandSize + BYTE;
 
 			break;
 		case SYMBOL_PCREL:
-			destination = new Operand("r7", matches[1], WORD + BYTE, PCRELATIVE, REG_IND_16);
+			destination.reset(new Operand("r7", matches[1], WORD + BYTE, PCRELATIVE, REG_IND_16));
 			size += WORD + BYTE;
 
 			break;
@@ -137,7 +157,7 @@ Instruction* Instruction::extract(queue<string>& tokens, smatch& matches, uint16
 				throw AssemblingException(line, "Byte indicator isn't expected for WORD operand size!");
 
 			if (value == "psw") {
-				destination = new Operand(value, matches[2], BYTE, PSW, REG_DIR);
+				destination.reset(new Operand(value, matches[2], BYTE, PSW, REG_DIR));
 			}
 			else {
 				if (value == "sp") value = "r6";
@@ -146,7 +166,7 @@ Instruction* Instruction::extract(queue<string>& tokens, smatch& matches, uint16
 				if (value == "r5" && mnemonic == "div")
 					throw AssemblingException(line, "Register R5 is reserved for the remainder of division!");
 
-				destination = new Operand(value, matches[2], BYTE, REGISTER, REG_DIR);
+				destination.reset(new Operand(value, matches[2], BYTE, REGISTER, REG_DIR));
 			}
 
 			size += BYTE;
@@ -160,7 +180,7 @@ Instruction* Instruction::extract(queue<string>& tokens, smatch& matches, uint16
 			string value = matches[1];
 
 			if (value == "psw") {
-				destination = new Operand(value, "", BYTE, PSW, REG_IND);
+				destination.reset(new Operand(value, "", BYTE, PSW, REG_IND));
 			}
 			else {
 				if (value == "sp") value = "r6";
@@ -169,7 +189,7 @@ Instruction* Instruction::extract(queue<string>& tokens, smatch& matches, uint16
 				if (value == "r5" && mnemonic == "div")
 					throw AssemblingException(line, "Register R5 is reserved for the remainder of division!");
 
-				destination = new Operand(value, "", BYTE, REGISTER, REG_IND);
+				destination.reset(new Operand(value, "", BYTE, REGISTER, REG_IND));
 			}
 
 			size += BYTE;
@@ -188,7 +208,7 @@ Instruction* Instruction::extract(queue<string>& tokens, smatch& matches, uint16
 				throw AssemblingException(line, "Register R5 is reserved for the remainder of division!");
 
 			OperandType type;
-			if (regex_match(matches[2].str(), regex("^[a-zA-Z_]\\w*$")))
+			if (regex_match(matches[2].str(), symbolName))
 				type = DISPL_SYMBOL;
 			else
 				type = DISPL_VALUE;
@@ -197,15 +217,15 @@ Instruction* Instruction::extract(queue<string>& tokens, smatch& matches, uint16
 			OperandSize displacementSize = WORD;
 
 			if (type == DISPL_VALUE) {
-				int16_t value = strtol(matches[2].str().c_str(), NULL, 0);
+				long value = strtol(matches[2].str().c_str(), NULL, 0);
 
-				if ((value & 0xFF00) == 0) {
+				if (value >= 0 && value <= 0xFF) {
 					addressing = REG_IND_8;
 					displacementSize = BYTE;
 				}
 			}
 
-			destination = new Operand(value, matches[2], displacementSize + BYTE, type, addressing);
+			destination.reset(new Operand(value, matches[2], displacementSize + BYTE, type, addressing));
 			size += displacementSize + BYTE;
 
 			break;
@@ -214,7 +234,7 @@ Instruction* Instruction::extract(queue<string>& tokens, smatch& matches, uint16
 			if (mnemonic != "int" && mnemonic != "push")
 				throw AssemblingException(line, "Immediate value is not allowed as a destination operand!");
 
-			destination = new Operand(matches[0], "", operandSize + BYTE, IMMED_VALUE, IMMED);
+			destination.reset(new Operand(matches[0], "", operandSize + BYTE, IMMED_VALUE, IMMED));
 			size += operandSize + BYTE;
 
 			break;
@@ -222,7 +242,7 @@ Instruction* Instruction::extract(queue<string>& tokens, smatch& matches, uint16
 			if (Utils::isJump(mnemonic))
 				throw AssemblingException(line, "Invalid addressing type for jump instructions!");
 
-			destination = new Operand(matches[1], "", WORD + BYTE, MEMORY_VALUE, MEMORY);
+			destination.reset(new Operand(matches[1], "", WORD + BYTE, MEMORY_VALUE, MEMORY));
 			size += WORD + BYTE;
 
 			break;
@@ -243,7 +263,7 @@ Instruction* Instruction::extract(queue<string>& tokens, smatch& matches, uint16
 
 		switch (tokenType) {
 		case SYMBOL:
-			source = new Operand(matches[0], "", WORD + BYTE, MEMORY_SYMBOL, MEMORY);
+			source.reset(new Operand(matches[0], "", WORD + BYTE, MEMORY_SYMBOL, MEMORY));
 			size += WORD + BYTE;
 
 			break;
@@ -251,12 +271,12 @@ Instruction* Instruction::extract(queue<string>& tokens, smatch& matches, uint16
 			if (mnemonic == "xchg")
 				throw AssemblingException(line, "Immediate value isn't legal operand for \"xchg\" instruction!");
 
-			source = new Operand(matches[1], "", operandSize + BYTE, IMMED_SYMBOL, IMMED);
+			source.reset(new Operand(matches[1], "", operandSize + BYTE, IMMED_SYMBOL, IMMED));
 			size += operandSize + BYTE;
 
 			break;
 		case SYMBOL_PCREL:
-			source = new Operand("r7", matches[1], WORD + BYTE, PCRELATIVE, REG_IND_16);
+			source.reset(new Operand("r7", matches[1], WORD + BYTE, PCRELATIVE, REG_IND_16));
 			size += WORD + BYTE;
 
 			break;
@@ -270,13 +290,13 @@ Instruction* Instruction::extract(queue<string>& tokens, smatch& matches, uint16
 				throw AssemblingException(line, "Byte indicator must be specified for BYTE operand size!");
 
 			if (value == "psw") {
-				source = new Operand(value, matches[2], BYTE, PSW, REG_DIR);
+				source.reset(new Operand(value, matches[2], BYTE, PSW, REG_DIR));
 			}
 			else {
 				if (value == "sp") value = "r6";
 				else if (value == "pc") value = "r7";
 
-				source = new Operand(value, matches[2], BYTE, REGISTER, REG_DIR);
+				source.reset(new Operand(value, matches[2], BYTE, REGISTER, REG_DIR));
 			}
 
 			size += BYTE;
@@ -287,13 +307,13 @@ Instruction* Instruction::extract(queue<string>& tokens, smatch& matches, uint16
 			string value = matches[1];
 
 			if (value == "psw") {
-				source = new Operand(value, "", BYTE, PSW, REG_IND);
+				source.reset(new Operand(value, "", BYTE, PSW, REG_IND));
 			}
 			else {
 				if (value == "sp") value = "r6";
 				else if (value == "pc") value = "r7";
 
-				source = new Operand(value, "", BYTE, REGISTER, REG_IND);
+				source.reset(new Operand(value, "", BYTE, REGISTER, REG_IND));
 			}
 
 			size += BYTE;
@@ -307,7 +327,7 @@ Instruction* Instruction::extract(queue<string>& tokens, smatch& matches, uint16
 			else if (value == "pc") value = "r7";
 			
 			OperandType type;
-			if (regex_match(matches[2].str(), regex("^[a-zA-Z_]\\w*$")))
+			if (regex_match(matches[2].str(), symbolName))
 				type = DISPL_SYMBOL;
 			else
 				type = DISPL_VALUE;
@@ -316,15 +336,15 @@ Instruction* Instruction::extract(queue<string>& tokens, smatch& matches, uint16
 			OperandSize displacementSize = WORD;
 
 			if (type == DISPL_VALUE) {
-				int16_t value = strtol(matches[2].str().c_str(), NULL, 0);
+				long value = strtol(matches[2].str().c_str(), NULL, 0);
 
-				if ((value & 0xFF00) == 0) {
+				if (value >= 0 && value <= 0xFF) {
 					addressing = REG_IND_8;
 					displacementSize = BYTE;
 				}
 			}
 
-			source = new Operand(value, matches[2], displacementSize + BYTE, type, addressing);
+			source.reset(new Operand(value, matches[2], displacementSize + BYTE, type, addressing));
 			size += displacementSize + BYTE;
 
 			break;
@@ -333,12 +353,12 @@ Instruction* Instruction::extract(queue<string>& tokens, smatch& matches, uint16
 			if (mnemonic == "xchg")
 				throw AssemblingException(line, "Immediate value isn't legal operand for \"xchg\" instruction!");
 
-			source = new Operand(matches[0], "", operandSize + BYTE, IMMED_VALUE, IMMED);
+			source.reset(new Operand(matches[0], "", operandSize + BYTE, IMMED_VALUE, IMMED));
 			size += operandSize + BYTE;
 
 			break;
 		case OPERAND_MEMORY:
-			source = new Operand(matches[1], "", WORD + BYTE, MEMORY_VALUE, MEMORY);
+			source.reset(new Operand(matches[1], "", WORD + BYTE, MEMORY_VALUE, MEMORY));
 			size += WORD + BYTE;
 
 			break;
@@ -348,10 +368,10 @@ Instruction* Instruction::extract(queue<string>& tokens, smatch& matches, uint16
 		}
 	}
 
-	return new Instruction(code, size, operandSize, destination, source);
+	return new Instruction(code, size, operandSize, destination.release(), source.release());
 }
 
-Instruction* Instruction::extract(uint8_t* memory, uint16_t PC) {
+Instruction* Instruction::extract(const uint8_t* memory, uint32_t PC) {
 	uint8_t byte = memory[PC++];
 
 	size_t size = BYTE;
@@ -359,9 +379,13 @@ Instruction* Instruction::extract(uint8_t* memory, uint16_t PC) {
 	InstructionCode code = (InstructionCode)(byte >> CODE_OFFSET);
 	OperandSize operandSize = (OperandSize)((byte >> SIZE_OFFSET & 1) + 1);
 
+	if (code < HALT || code > IRET)
+		throw EmulatingException("Unrecognized instruction code!");
+
 	uint8_t operandNumber = Instruction::operands[code];
 
-	Operand* operands[2]{ nullptr, nullptr };
+	// owned here until the instruction is built, a bad operand throws
+	unique_ptr<Operand> operands[2];
 
 	for (int i = 0; i < operandNumber; i++) {
 		byte = memory[PC++];
@@ -376,7 +400,7 @@ Instruction* Instruction::extract(uint8_t* memory, uint16_t PC) {
 			if (operandSize == WORD)
 				value |= memory[PC++] << 8;
 
-			operands[i] = new CodedOperand(value, 0, addressing);
+			operands[i].reset(new CodedOperand(value, 0, addressing));
 
 			size += operandSize;
 			break;
@@ -384,21 +408,21 @@ Instruction* Instruction::extract(uint8_t* memory, uint16_t PC) {
 		case REG_DIR: {
 			int16_t value = byte >> REGS_OFFSET & 0xF;
 
-			operands[i] = new CodedOperand(value, byte & 1, addressing);
+			operands[i].reset(new CodedOperand(value, byte & 1, addressing));
 
 			break;
 		}
 		case REG_IND: {
 			int16_t value = byte >> REGS_OFFSET & 0xF;
 
-			operands[i] = new CodedOperand(value, 0, addressing);
+			operands[i].reset(new CodedOperand(value, 0, addressing));
 
 			break;
 		}
 		case REG_IND_8: {
 			int16_t value = byte >> REGS_OFFSET & 0xF;
 
-			operands[i] = new CodedOperand(value, memory[PC++], addressing);
+			operands[i].reset(new CodedOperand(value, memory[PC++], addressing));
 
 			size += BYTE;
 			break;
@@ -409,7 +433,7 @@ Instruction* Instruction::extract(uint8_t* memory, uint16_t PC) {
 			int16_t displacement = memory[PC++];
 			displacement |= memory[PC++] << 8;
 
-			operands[i] = new CodedOperand(value, displacement, addressing);
+			operands[i].reset(new CodedOperand(value, displacement, addressing));
 
 			size += WORD;
 			break;
@@ -418,7 +442,7 @@ Instruction* Instruction::extract(uint8_t* memory, uint16_t PC) {
 			int16_t address = memory[PC++];
 			address |= memory[PC++] << 8;
 
-			operands[i] = new CodedOperand(address, 0, addressing);
+			operands[i].reset(new CodedOperand(address, 0, addressing));
 
 			size += WORD;
 			break;
@@ -429,5 +453,57 @@ Instruction* Instruction::extract(uint8_t* memory, uint16_t PC) {
 		}
 	}
 
-	return new Instruction(code, size, operandSize, operands[0], operands[1]);
+	return new Instruction(code, size, operandSize, operands[0].release(), operands[1].release());
+}
+
+
+void Instruction::format(string& out) const {
+	out += mnemonics[code];
+
+	// only data instructions take the operand size suffix
+	if (code >= XCHG && code <= POP && code != INT && operandSize == BYTE) out += 'b';
+
+	const Operand* list[] = { destination, source };
+
+	for (int i = 0; i < 2 && list[i]; i++) {
+		const CodedOperand* operand = dynamic_cast<const CodedOperand*>(list[i]);
+		if (!operand) break;
+
+		out += i == 0 ? " " : ", ";
+
+		string reg = operand->value == PSW_CODE ? "psw" : "r" + to_string(operand->value);
+		char number[16];
+
+		switch (operand->addressing) {
+		case IMMED:
+			if ((uint16_t)operand->value < 0x100) {
+				out += to_string(operand->value);
+			}
+			else {
+				snprintf(number, sizeof(number), "0x%04X", (uint16_t)operand->value);
+				out += number;
+			}
+			break;
+		case REG_DIR:
+			out += reg;
+
+			if (operandSize == BYTE && reg != "psw")
+				out += operand->displacement ? 'h' : 'l';
+			break;
+		case REG_IND:
+			out += '[' + reg + ']';
+			break;
+		case REG_IND_8:
+			out += reg + '[' + to_string((uint8_t)operand->displacement) + ']';
+			break;
+		case REG_IND_16:
+			snprintf(number, sizeof(number), "0x%04X", (uint16_t)operand->displacement);
+			out += reg + '[' + number + ']';
+			break;
+		case MEMORY:
+			snprintf(number, sizeof(number), "*0x%04X", (uint16_t)operand->value);
+			out += number;
+			break;
+		}
+	}
 }
\ No newline at end of file
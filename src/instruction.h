@@ -13,9 +13,16 @@ class Instruction {
 public:
 	~Instruction();
 
-	static Instruction* extract(std::queue<std::string>& tokens, std::smatch& matches, uint16_t line);
+	static Instruction* extract(std::queue<std::string>& tokens, std::smatch& matches, uint32_t line);
 
-	static Instruction* extract(uint8_t* memory, uint16_t PC);
+	static Instruction* extract(const uint8_t* memory, uint32_t PC);
+
+	size_t getSize() const {
+		return size;
+	}
+
+	// appends assembly text of an instruction extracted from memory
+	void format(std::string& out) const;
 
 	friend class Emulator;
 	friend class Assembler;
@@ -63,6 +70,8 @@ private:
 
 	static uint8_t operands[];
 
+	static const char* mnemonics[];
+
 	static std::unordered_map<std::string, std::pair<InstructionCode, uint8_t>> instructionMap;
 
 	InstructionCode code;
@@ -0,0 +1,118 @@
+#include <string>
+#include <vector>
+
+#include "macro.h"
+
+using namespace std;
+
+
+StatementCursor::StatementCursor(const Block* program, const vector<vector<string>>& t_assembly, Numbering& t_numbering, size_t first) :
+	assembly(t_assembly), numbering(t_numbering) {
+	frames.push_back({ program, first, 1, NO_BINDING, {}, 0 });
+
+	settle();
+}
+
+
+void StatementCursor::next() {
+	++frames.back().item;
+	++numbering.statements;
+
+	settle();
+}
+
+
+void StatementCursor::settle() {
+	while (!frames.empty()) {
+		Frame& frame = frames.back();
+
+		if (frame.item == frame.block->items.size()) {
+			if (--frame.remaining > 0) {
+				frame.item = 0;
+				continue;
+			}
+
+			frames.pop_back();
+
+			if (!frames.empty()) ++frames.back().item;
+			continue;
+		}
+
+		const Block::Item& item = frame.block->items[frame.item];
+
+		if (!item.block) return;
+
+		if (item.count == 0) {
+			++frame.item;
+			continue;
+		}
+
+		Frame nested = { item.block, 0, item.count, frame.binding, {}, 0 };
+
+		if (item.block->macro) {
+			for (const string& argument : item.arguments)
+				nested.arguments.push_back(substitute(argument, frame.binding));
+
+			nested.binding = frames.size();
+			nested.expansion = numbering.expansions++;
+		}
+
+		frames.push_back(nested);
+	}
+}
+
+
+const vector<string>& StatementCursor::tokens() {
+	const vector<string>& statement = assembly[source()];
+	size_t binding = frames.back().binding;
+
+	if (binding == NO_BINDING) return statement;
+
+	substituted.clear();
+
+	for (const string& token : statement)
+		substituted.push_back(substitute(token, binding));
+
+	return substituted;
+}
+
+
+string StatementCursor::substitute(const string& token, size_t binding) const {
+	if (binding == NO_BINDING || token.find('\\') == string::npos) return token;
+
+	const Frame& frame = frames[binding];
+	const vector<string>& parameters = frame.block->parameters;
+
+	string result;
+
+	for (size_t i = 0; i < token.size(); i++) {
+		if (token[i] != '\\' || i + 1 == token.size()) {
+			result += token[i];
+			continue;
+		}
+
+		if (token[i + 1] == '@') {
+			result += to_string(frame.expansion);
+			++i;
+			continue;
+		}
+
+		// longest parameter name at this position
+		size_t parameter = parameters.size();
+
+		for (size_t j = 0; j < parameters.size(); j++)
+			if (!token.compare(i + 1, parameters[j].size(), parameters[j]) &&
+				(parameter == parameters.size() || parameters[j].size() > parameters[parameter].size()))
+				parameter = j;
+
+		if (parameter == parameters.size()) {
+			result += token[i];
+			continue;
+		}
+
+		result += frame.arguments[parameter];
+		i += parameters[parameter].size();
+	}
+
+	return result;
+}
\ No newline at end of file
@@ -0,0 +1,105 @@
+#ifndef _MACRO_H_
+#define _MACRO_H_
+
+#include <string>
+#include <vector>
+
+// Statements of the program, a .macro body or a .rept block. Expansions are
+// never copied: an item refers to a nested block that is walked count times
+// with its arguments bound, and the passes iterate the tree with a
+// StatementCursor, so memory follows the source rather than the expansion.
+class Block {
+public:
+	Block(const std::string& t_name, bool t_macro) : name(t_name), macro(t_macro) {}
+
+	friend class Assembler;
+	friend class StatementCursor;
+private:
+	struct Item {
+		// statement in Assembler::assembly, or nested block when block is set
+		size_t statement;
+		const Block* block;
+
+		uint32_t count;
+
+		// macro arguments, may refer to parameters of an enclosing macro
+		std::vector<std::string> arguments;
+	};
+
+	std::string name;
+	bool macro;
+
+	// macro parameters, referenced as \name inside the body
+	std::vector<std::string> parameters;
+
+	std::vector<Item> items;
+};
+
+
+// walks the statements of a block in program order, expanding nested blocks
+class StatementCursor {
+public:
+	// running numbers of statements and macro expansions, a program read in
+	// chunks is walked by one cursor per chunk that carry on the numbering
+	struct Numbering {
+		size_t statements;
+		size_t expansions;
+	};
+
+	// walks program from its item first on
+	StatementCursor(const Block* program, const std::vector<std::vector<std::string>>& t_assembly, Numbering& t_numbering, size_t first);
+
+	bool valid() const {
+		return !frames.empty();
+	}
+
+	void next();
+
+	// running number of the statement, the same in every walk
+	size_t index() const {
+		return numbering.statements;
+	}
+
+	// the statement is reached through a .rept or macro block, not the program itself
+	bool expanded() const {
+		return frames.size() > 1;
+	}
+
+	// the statement in Assembler::assembly
+	size_t source() const {
+		return frames.back().block->items[frames.back().item].statement;
+	}
+
+	// tokens with macro parameters (and \@, the number of the expansion) substituted,
+	// valid until next()
+	const std::vector<std::string>& tokens();
+private:
+	struct Frame {
+		const Block* block;
+		size_t item;
+		uint32_t remaining;
+
+		// frame of the innermost macro expansion, NO_BINDING outside macros
+		size_t binding;
+
+		// bound arguments and expansion number of macro frames
+		std::vector<std::string> arguments;
+		size_t expansion;
+	};
+
+	static const size_t NO_BINDING = (size_t)-1;
+
+	// moves to the next statement at or after the current item
+	void settle();
+
+	std::string substitute(const std::string& token, size_t binding) const;
+
+	const std::vector<std::vector<std::string>>& assembly;
+
+	std::vector<Frame> frames;
+	std::vector<std::string> substituted;
+
+	Numbering& numbering;
+};
+
+#endif
\ No newline at end of file
@@ -1,30 +1,153 @@
 #include <iostream>
 #include <cstring>
+#include <cstdlib>
+#include <cstdint>
 #include <exception>
 
 #include "assembler.h"
 
+static const char* usage = "Program should be called as: assembler [--no-listing] [--hash-index] [--compress] [-fpic] [--stream] "
+							"[--threads n] [--max-errors n] [-MD] [-MF dependency_file] [--if-changed] [--format object|binary|ihex] "
+							"[--section-start section=address]... -o output_file input_file.\n"
+							"       assembler [--max-errors n] --check input_file (reports errors, writes nothing).\n"
+							"       --threads lexes a large input on n threads (0 for one per core), default 1.\n"
+							"       --max-errors reports up to n errors (0 for all) before stopping, default 1.\n"
+							"       -MD writes a make rule for the output (-MF names its file), --if-changed skips an up to date object.\n\n";
+
 int main(int argc, char* argv[]) {
-	const uint8_t args = 4;
-	const char* option = "-o";
+	Assembler::Options options;
+
+	std::string input;
+	std::string output;
+
+	for (int i = 1; i < argc; i++) {
+		if (!strcmp(argv[i], "-o")) {
+			if (i + 1 == argc) {
+				std::cerr << "ERROR: Missing output file!\n";
+				std::cout << usage;
+				return 1;
+			}
+
+			output = argv[++i];
+		}
+		else if (!strcmp(argv[i], "--no-listing")) {
+			options.listing = false;
+		}
+		else if (!strcmp(argv[i], "--hash-index")) {
+			options.hashIndex = true;
+		}
+		else if (!strcmp(argv[i], "--compress")) {
+			options.compress = true;
+		}
+		else if (!strcmp(argv[i], "--check")) {
+			options.check = true;
+		}
+		else if (!strcmp(argv[i], "-MD")) {
+			options.dependencies = true;
+		}
+		else if (!strcmp(argv[i], "-MF")) {
+			if (i + 1 == argc) {
+				std::cerr << "ERROR: Missing dependency file!\n";
+				std::cout << usage;
+				return 1;
+			}
+
+			options.dependencies = true;
+			options.dependencyFile = argv[++i];
+		}
+		else if (!strcmp(argv[i], "--if-changed")) {
+			options.ifChanged = true;
+		}
+		else if (!strcmp(argv[i], "--stream")) {
+			options.stream = true;
+		}
+		else if (!strcmp(argv[i], "--threads") && i + 1 < argc) {
+			char* end = nullptr;
+			unsigned long threads = strtoul(argv[++i], &end, 10);
+
+			if (!*argv[i] || *end || threads > 256) {
+				std::cerr << "ERROR: Invalid thread count \"" << argv[i] << "\"!\n";
+				std::cout << usage;
+				return 1;
+			}
+
+			options.threads = threads;
+		}
+		else if (!strcmp(argv[i], "--max-errors") && i + 1 < argc) {
+			char* end = nullptr;
+			unsigned long limit = strtoul(argv[++i], &end, 10);
+
+			if (!*argv[i] || *end || limit > UINT32_MAX) {
+				std::cerr << "ERROR: Invalid error limit \"" << argv[i] << "\"!\n";
+				std::cout << usage;
+				return 1;
+			}
 
-	if (argc != args) {
+			options.errorLimit = limit;
+		}
+		else if (!strcmp(argv[i], "-fpic")) {
+			options.pic = true;
+		}
+		else if (!strcmp(argv[i], "--format") && i + 1 < argc) {
+			std::string format = argv[++i];
+
+			if (format == "object")
+				options.format = OBJECT;
+			else if (format == "binary")
+				options.format = BINARY;
+			else if (format == "ihex")
+				options.format = IHEX;
+			else {
+				std::cerr << "ERROR: Unknown output format \"" << format << "\"!\n";
+				std::cout << usage;
+				return 1;
+			}
+		}
+		else if (!strcmp(argv[i], "--section-start") && i + 1 < argc) {
+			std::string placement = argv[++i];
+			size_t separator = placement.find('=');
+
+			char* end = nullptr;
+			unsigned long address = separator == std::string::npos ? 0 : strtoul(placement.c_str() + separator + 1, &end, 0);
+
+			if (separator == std::string::npos || separator == 0 || !end || *end || end == placement.c_str() + separator + 1 || address > 0xFFFF) {
+				std::cerr << "ERROR: Invalid section start \"" << placement << "\"!\n";
+				std::cout << usage;
+				return 1;
+			}
+
+			options.sectionStarts[placement.substr(0, separator)] = address;
+		}
+		else if (argv[i][0] == '-') {
+			std::cerr << "ERROR: Unrecognized option \"" << argv[i] << "\"!\n";
+			std::cout << usage;
+			return 1;
+		}
+		else if (input.empty()) {
+			input = argv[i];
+		}
+		else {
+			std::cerr << "ERROR: Wrong number of arguments!\n";
+			std::cout << usage;
+			return 1;
+		}
+	}
+
+	if (input.empty() || (output.empty() && !options.check)) {
 		std::cerr << "ERROR: Wrong number of arguments!\n";
-		std::cout << "Program should be called as: assembler -o output_file input_file.\n\n";
+		std::cout << usage;
 		return 1;
 	}
 
-	if (strcmp(argv[1], option)) {
-		std::cerr << "ERROR: Unrecognized option \"" << argv[1] << "\"!\n";
-		std::cout << "Program should be called as: assembler -o output_file input_file.\n\n";
+	// only object files have room for the stamp
+	if (options.ifChanged && options.format != OBJECT) {
+		std::cerr << "ERROR: --if-changed needs an object file output!\n";
+		std::cout << usage;
 		return 1;
 	}
 
-	std::string input  = argv[3];
-	std::string output = argv[2];
-
 	try {
-		Assembler assembler;
+		Assembler assembler(options);
 		
 		assembler.assemble(input, output);
 	}
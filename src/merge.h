@@ -0,0 +1,28 @@
+#ifndef _MERGE_H_
+#define _MERGE_H_
+
+#include <string>
+#include <vector>
+
+// Data of a merge (M) section collected by the first pass: everything from a
+// label (or, in strings (S) sections, up to a NUL terminator) to the next
+// boundary. Identical entities are kept once and their labels redirected.
+class MergeEntity {
+public:
+	MergeEntity(uint32_t t_start) : start(t_start), mergeable(true) {}
+
+	friend class Assembler;
+private:
+	uint32_t start;
+
+	// contents, only known for literal initial values
+	std::string bytes;
+	bool mergeable;
+
+	std::vector<std::string> labels;
+
+	// running numbers of the statements (StatementCursor::index)
+	std::vector<size_t> statements;
+};
+
+#endif
\ No newline at end of file
@@ -0,0 +1,931 @@
+#include <string>
+#include <vector>
+#include <ostream>
+#include <cstring>
+#include <cstddef>
+#include <algorithm>
+#include <unordered_map>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "exceptions.h"
+#include "types.h"
+#include "utils.h"
+#include "symbol.h"
+#include "section.h"
+#include "relocation.h"
+#include "object.h"
+
+using namespace std;
+
+
+static uint32_t align(uint32_t offset, uint32_t alignment) {
+	return (offset + alignment - 1) / alignment * alignment;
+}
+
+
+ObjectWriter::ObjectWriter(const unordered_map<string, Symbol*>& t_symbolTable,
+						   const unordered_map<string, Section*>& sectionTable,
+						   const vector<Relocation*>& relocationTable) :
+	symbolTable(t_symbolTable), relocations(relocationTable), hashIndex(false), compression(false) {
+	collectSymbols();
+
+	for (const auto& entry : sectionTable) sections.push_back(entry.second);
+
+	// tables are written in order of their entry numbers
+	sort(sections.begin(), sections.end(), [](const Section* a, const Section* b) {
+		return a->sectionTableEntry < b->sectionTableEntry;
+	});
+
+	for (uint32_t i = 0; i < sections.size(); i++) sectionIndices[sections[i]->name] = i;
+}
+
+
+void ObjectWriter::collectSymbols() {
+	// the second pass adds undefined symbols as it finds them, after all others
+	if (symbols.size() == symbolTable.size()) return;
+
+	symbols.clear();
+	for (const auto& entry : symbolTable) symbols.push_back(entry.second);
+
+	sort(symbols.begin(), symbols.end(), [](const Symbol* a, const Symbol* b) {
+		return a->symbolTableEntry < b->symbolTableEntry;
+	});
+
+	symbolIndices.clear();
+	for (uint32_t i = 0; i < symbols.size(); i++) symbolIndices[symbols[i]->name] = i;
+}
+
+
+void ObjectWriter::addString(const string& value) {
+	if (!value.empty()) stringOffsets.insert({ value, 0 });
+}
+
+
+void ObjectWriter::layoutStrings() {
+	vector<const string*> names;
+	names.reserve(stringOffsets.size());
+
+	for (const auto& entry : stringOffsets) names.push_back(&entry.first);
+
+	// descending by reversed text: a string is preceded by all strings it is
+	// a suffix of, so sharing is found by comparing with the last one written
+	sort(names.begin(), names.end(), [](const string* a, const string* b) {
+		return lexicographical_compare(b->rbegin(), b->rend(), a->rbegin(), a->rend());
+	});
+
+	strings.assign(1, '\0');
+
+	const string* previous = nullptr;
+	uint32_t previousOffset = 0;
+
+	for (const string* name : names) {
+		uint32_t& offset = stringOffsets[*name];
+
+		if (previous && previous->size() >= name->size() &&
+			previous->compare(previous->size() - name->size(), name->size(), *name) == 0) {
+			offset = previousOffset + previous->size() - name->size();
+			continue;
+		}
+
+		previous = name;
+		previousOffset = offset = strings.size();
+
+		strings += *name;
+		strings += '\0';
+	}
+}
+
+
+uint32_t ObjectWriter::stringOffset(const string& value) const {
+	auto entry = stringOffsets.find(value);
+	return entry == stringOffsets.end() ? 0 : entry->second;
+}
+
+
+uint32_t ObjectWriter::symbolIndex(const string& name) const {
+	auto entry = symbolIndices.find(name);
+	return entry == symbolIndices.end() ? NO_INDEX : entry->second;
+}
+
+
+uint32_t ObjectWriter::sectionIndex(const string& name) const {
+	auto entry = sectionIndices.find(name);
+	return entry == sectionIndices.end() ? NO_INDEX : entry->second;
+}
+
+
+void ObjectWriter::write(string& out) {
+	out.clear();
+
+	emit([&out](const char* data, size_t size) { out.append(data, size); });
+}
+
+
+void ObjectWriter::write(ostream& out) {
+	emit([&out](const char* data, size_t size) { out.write(data, size); });
+}
+
+
+void ObjectWriter::startSpill() {
+	if (contentsSpill) return;
+
+	contentsSpill.reset(new SpillFile());
+	relocationSpill.reset(new SpillFile());
+	lineRecords.reset(new SpillFile());
+
+	spilledSections.assign(sections.size(), SpilledSection());
+}
+
+
+void ObjectWriter::spillContents(Section* section) {
+	startSpill();
+
+	SpilledSection& spilled = spilledSections[sectionIndex(section->name)];
+
+	uint64_t position = contentsSpill->append(section->bytes.data(), section->bytes.size());
+	if (section->spilled == 0) spilled.contents = position;
+
+	section->spilled += section->bytes.size();
+	section->bytes.clear();
+}
+
+
+void ObjectWriter::spillRelocations(const Section* section) {
+	startSpill();
+	collectSymbols();
+
+	uint32_t index = sectionIndex(section->name);
+	SpilledSection& spilled = spilledSections[index];
+
+	vector<const Relocation*> group;
+	group.reserve(relocations.size());
+
+	for (const Relocation* relocation : relocations) {
+		if (sectionIndex(relocation->section) != index || symbolIndex(relocation->symbol) == NO_INDEX)
+			throw ObjectException("Relocation of \"" + relocation->symbol + "\" references unknown symbol or section!");
+
+		group.push_back(relocation);
+	}
+
+	if (spilled.relocationCount == 0) spilled.relocations = relocationSpill->size();
+
+	string out;
+	appendRelocations(out, group, spilled.previousRelocation);
+
+	relocationSpill->append(out);
+
+	spilled.relocationBytes += out.size();
+	spilled.relocationCount += group.size();
+}
+
+
+size_t ObjectWriter::spillLines(const Section* section, bool finished) {
+	startSpill();
+
+	const vector<SourceLine>& lines = section->lines;
+
+	// Section::addLine can still change the last two entries
+	size_t stable = finished ? lines.size() : max<size_t>(lines.size(), 2) - 2;
+
+	vector<LineRecord> records;
+	records.reserve(stable);
+
+	uint32_t index = sectionIndex(section->name);
+	size_t count = 0;
+
+	for (; count < stable; count++) {
+		// the rest lies past the section and is never written
+		if (lines[count].offset > section->size) {
+			count = lines.size();
+			break;
+		}
+
+		records.push_back({ index, lines[count].offset, lines[count].line, lines[count].file });
+	}
+
+	lineRecords->append(records.data(), records.size() * sizeof(LineRecord));
+
+	return count;
+}
+
+
+void ObjectWriter::spilledContents(const Section* section, const Sink& sink) const {
+	if (contentsSpill && section->spilled > 0)
+		contentsSpill->copy(spilledSections[sectionIndex(section->name)].contents, section->spilled, sink);
+}
+
+
+void ObjectWriter::emit(const Sink& sink) {
+	collectSymbols();
+
+	// all names share one string table, laid out before anything references it
+	stringOffsets.clear();
+
+	for (const Symbol* symbol : symbols)   addString(symbol->name);
+	for (const Section* section : sections) addString(section->name);
+	for (const string& file : sourceFiles)  addString(file);
+	for (const auto& entry : stamp)         addString(entry.first);
+
+	layoutStrings();
+
+	vector<SymbolEntry>  symbolEntries(symbols.size());
+	vector<SectionEntry> sectionEntries(sections.size());
+
+	for (size_t i = 0; i < symbols.size(); i++) {
+		const Symbol* symbol = symbols[i];
+		SymbolEntry& entry = symbolEntries[i];
+
+		entry.name     = littleEndian(stringOffset(symbol->name));
+		entry.section  = littleEndian(symbol->section == UNDEFINED ? NO_INDEX : sectionIndex(symbol->section));
+		entry.value    = littleEndian((int32_t)symbol->value);
+		entry.scope    = symbol->scope;
+		entry.type     = (uint8_t)symbol->type;
+		entry.defined  = symbol->defined;
+		entry.reserved = 0;
+	}
+
+	string relocationTable;
+	writeRelocations(relocationTable, sectionEntries);
+
+	string lineTable;
+
+	if (contentsSpill)
+		writeSpilledLines();
+	else
+		writeLines(lineTable);
+
+	// while streaming both tables were spilled as the sections were finished
+	uint32_t relocationSize = contentsSpill ? relocationSpill->size() : relocationTable.size();
+	uint32_t lineSize = contentsSpill ? lineSpill->size() : lineTable.size();
+
+	vector<StampEntry> stampEntries(stamp.size());
+
+	for (size_t i = 0; i < stamp.size(); i++) {
+		stampEntries[i].file     = littleEndian(stringOffset(stamp[i].first));
+		stampEntries[i].reserved = 0;
+		stampEntries[i].hash     = littleEndian(stamp[i].second);
+	}
+
+	// layout
+	ObjectHeader header;
+	memset(&header, 0, sizeof(ObjectHeader));
+
+	uint32_t offset = align(sizeof(ObjectHeader), TABLE_ALIGNMENT);
+
+	header.tables[SYMBOLS].offset = offset;
+	header.tables[SYMBOLS].count  = symbolEntries.size();
+	offset = align(offset + symbolEntries.size() * sizeof(SymbolEntry), TABLE_ALIGNMENT);
+
+	header.tables[SECTIONS].offset = offset;
+	header.tables[SECTIONS].count  = sectionEntries.size();
+	offset = align(offset + sectionEntries.size() * sizeof(SectionEntry), TABLE_ALIGNMENT);
+
+	header.tables[RELOCATIONS].offset = offset;
+	header.tables[RELOCATIONS].count  = relocationSize;
+	offset = align(offset + relocationSize, TABLE_ALIGNMENT);
+
+	string hashTable;
+	if (hashIndex) writeHashIndex(hashTable);
+
+	header.tables[HASH].offset = hashTable.empty() ? 0 : offset;
+	header.tables[HASH].count  = hashTable.size();
+	offset = align(offset + hashTable.size(), TABLE_ALIGNMENT);
+
+	header.tables[LINES].offset = lineSize == 0 ? 0 : offset;
+	header.tables[LINES].count  = lineSize;
+	offset = align(offset + lineSize, TABLE_ALIGNMENT);
+
+	header.tables[STAMP].offset = stampEntries.empty() ? 0 : offset;
+	header.tables[STAMP].count  = stampEntries.size();
+	offset = align(offset + stampEntries.size() * sizeof(StampEntry), TABLE_ALIGNMENT);
+
+	header.tables[STRINGS].offset = offset;
+	header.tables[STRINGS].count  = strings.size();
+	offset += strings.size();
+
+	// compressed contents, kept only where they are smaller
+	vector<string> packed(sections.size());
+	vector<bool> encoded(sections.size());
+
+	// position of the stored contents in the spill, compressed ones are appended to it
+	vector<uint64_t> spilled(sections.size());
+
+	for (size_t i = 0; i < sections.size(); i++) {
+		const Section* section = sections[i];
+		SectionEntry& entry = sectionEntries[i];
+
+		uint16_t flags = Utils::getFlagMask(section->flags);
+		uint32_t stored = contentsSpill ? section->spilled : section->bytes.size();
+
+		if (contentsSpill) spilled[i] = spilledSections[i].contents;
+
+		if (compression && stored > 0 && (flags & 1 << A) && !(flags & 1 << X)) {
+			// a spilled section is read back whole, one at a time
+			if (contentsSpill) {
+				vector<uint8_t> contents(stored);
+				contentsSpill->read(spilled[i], contents.data(), stored);
+
+				Utils::compressLZ(contents.data(), stored, packed[i]);
+			}
+			else {
+				Utils::compressLZ(section->bytes.data(), stored, packed[i]);
+			}
+
+			encoded[i] = packed[i].size() < stored;
+
+			if (encoded[i]) {
+				stored = packed[i].size();
+
+				if (contentsSpill) {
+					spilled[i] = contentsSpill->append(packed[i]);
+					string().swap(packed[i]);
+				}
+			}
+			else {
+				packed[i].clear();
+			}
+		}
+
+		offset = align(offset, OBJECT_ALIGNMENT);
+
+		entry.name     = littleEndian(stringOffset(section->name));
+		entry.symbol   = littleEndian(symbolIndex(section->name));
+		entry.flags    = littleEndian(flags);
+		entry.encoding = littleEndian((uint16_t)(encoded[i] ? LZ : STORED));
+		entry.size     = littleEndian((uint32_t)section->size);
+		entry.offset   = littleEndian(stored > 0 ? offset : 0);
+		entry.stored   = littleEndian(stored);
+
+		offset += stored;
+	}
+
+	memcpy(header.magic, OBJECT_MAGIC, sizeof(header.magic));
+	header.version = littleEndian(OBJECT_VERSION);
+	header.size    = littleEndian(offset);
+
+	for (uint8_t i = 0; i < OBJECT_TABLES; i++) {
+		header.tables[i].offset = littleEndian(header.tables[i].offset);
+		header.tables[i].count  = littleEndian(header.tables[i].count);
+	}
+
+	// pieces of the object in file order, the gaps between them are zero padding;
+	// spilled pieces are copied from their temporary file
+	struct Piece {
+		uint32_t offset;
+		const char* data;
+		uint32_t size;
+
+		const SpillFile* file;
+		uint64_t position;
+	};
+
+	vector<Piece> pieces;
+
+	pieces.push_back({ 0, (const char*)&header, sizeof(ObjectHeader) });
+
+	if (!symbolEntries.empty())
+		pieces.push_back({ littleEndian(header.tables[SYMBOLS].offset), (const char*)symbolEntries.data(), (uint32_t)(symbolEntries.size() * sizeof(SymbolEntry)) });
+
+	if (!sectionEntries.empty())
+		pieces.push_back({ littleEndian(header.tables[SECTIONS].offset), (const char*)sectionEntries.data(), (uint32_t)(sectionEntries.size() * sizeof(SectionEntry)) });
+
+	if (relocationSize > 0)
+		pieces.push_back({ littleEndian(header.tables[RELOCATIONS].offset), relocationTable.data(), relocationSize, relocationSpill.get(), 0 });
+
+	if (!hashTable.empty())
+		pieces.push_back({ littleEndian(header.tables[HASH].offset), hashTable.data(), (uint32_t)hashTable.size() });
+
+	if (lineSize > 0)
+		pieces.push_back({ littleEndian(header.tables[LINES].offset), lineTable.data(), lineSize, lineSpill.get(), 0 });
+
+	if (!stampEntries.empty())
+		pieces.push_back({ littleEndian(header.tables[STAMP].offset), (const char*)stampEntries.data(), (uint32_t)(stampEntries.size() * sizeof(StampEntry)) });
+
+	pieces.push_back({ littleEndian(header.tables[STRINGS].offset), strings.data(), (uint32_t)strings.size() });
+
+	for (size_t i = 0; i < sections.size(); i++) {
+		const char* contents = packed[i].empty() ? (const char*)sections[i]->bytes.data() : packed[i].data();
+		uint32_t stored = littleEndian(sectionEntries[i].stored);
+
+		if (stored > 0) pieces.push_back({ littleEndian(sectionEntries[i].offset), contents, stored, contentsSpill.get(), spilled[i] });
+	}
+
+	const uint32_t size = offset;
+
+	auto walk = [&pieces, size](const Sink& out) {
+		static const char zeros[OBJECT_ALIGNMENT] = { 0 };
+		uint32_t position = 0;
+
+		for (size_t i = 0; i <= pieces.size(); i++) {
+			uint32_t end = i < pieces.size() ? pieces[i].offset : size;
+
+			for (uint32_t length; position < end; position += length) {
+				length = min<uint32_t>(end - position, sizeof(zeros));
+				out(zeros, length);
+			}
+
+			if (i == pieces.size()) break;
+
+			if (pieces[i].file)
+				pieces[i].file->copy(pieces[i].position, pieces[i].size, out);
+			else
+				out(pieces[i].data, pieces[i].size);
+
+			position += pieces[i].size;
+		}
+	};
+
+	// the checksum covers the object with its own field still zero
+	uint32_t checksum = 0;
+
+	walk([&checksum](const char* data, size_t length) {
+		checksum = Utils::crc32((const uint8_t*)data, length, checksum);
+	});
+
+	header.checksum = littleEndian(checksum);
+
+	walk(sink);
+}
+
+
+void ObjectWriter::writeRelocations(string& out, vector<SectionEntry>& sectionEntries) const {
+	// symbol indices share a 32-bit word with the relocation type
+	if (symbols.size() > (NO_INDEX >> RELOCATION_TYPE_BITS))
+		throw ObjectException("Too many symbols for relocation entries!");
+
+	// groups were spilled as the sections were finished, empty ones start where the previous ended
+	if (contentsSpill) {
+		uint32_t end = 0;
+
+		for (size_t i = 0; i < sections.size(); i++) {
+			const SpilledSection& spilled = spilledSections[i];
+			uint32_t start = spilled.relocationCount > 0 ? spilled.relocations : end;
+
+			sectionEntries[i].relocations     = littleEndian(start);
+			sectionEntries[i].relocationCount = littleEndian(spilled.relocationCount);
+
+			end = start + spilled.relocationBytes;
+		}
+
+		return;
+	}
+
+	vector<vector<const Relocation*>> groups(sections.size());
+
+	for (const Relocation* relocation : relocations) {
+		uint32_t section = sectionIndex(relocation->section);
+
+		if (section == NO_INDEX || symbolIndex(relocation->symbol) == NO_INDEX)
+			throw ObjectException("Relocation of \"" + relocation->symbol + "\" references unknown symbol or section!");
+
+		groups[section].push_back(relocation);
+	}
+
+	// about three bytes per relocation
+	out.reserve(relocations.size() * 3);
+
+	for (size_t i = 0; i < groups.size(); i++) {
+		sectionEntries[i].relocations     = littleEndian((uint32_t)out.size());
+		sectionEntries[i].relocationCount = littleEndian((uint32_t)groups[i].size());
+
+		uint32_t previous = 0;
+		appendRelocations(out, groups[i], previous);
+	}
+}
+
+
+void ObjectWriter::appendRelocations(string& out, vector<const Relocation*>& group, uint32_t& previous) const {
+	stable_sort(group.begin(), group.end(), [](const Relocation* a, const Relocation* b) {
+		return a->offset < b->offset;
+	});
+
+	for (const Relocation* relocation : group) {
+		uint32_t offset = relocation->offset;
+
+		Utils::appendULEB128(out, offset - previous);
+		Utils::appendULEB128(out, symbolIndex(relocation->symbol) << RELOCATION_TYPE_BITS | relocation->type);
+
+		previous = offset;
+	}
+}
+
+
+void ObjectWriter::writeLines(string& out) const {
+	for (uint32_t i = 0; i < sections.size(); i++) {
+		const vector<SourceLine>& lines = sections[i]->lines;
+
+		for (size_t first = 0; first < lines.size();) {
+			size_t last = lineGroup(sections[i], first);
+
+			if (last == first) break;
+
+			appendLines(out, i, lines, first, last);
+			first = last;
+		}
+	}
+}
+
+
+void ObjectWriter::writeSpilledLines() {
+	lineSpill.reset(new SpillFile());
+
+	// entries of a group wait here until the one ending it is read
+	vector<SourceLine> group;
+	group.reserve(LINE_GROUP_ENTRIES);
+
+	uint32_t section = 0;
+	string out;
+
+	auto close = [&]() {
+		if (!group.empty()) appendLines(out, section, group, 0, group.size());
+		group.clear();
+
+		if (out.size() >= SPILL_PIECE) {
+			lineSpill->append(out);
+			out.clear();
+		}
+	};
+
+	// pieces hold whole records
+	lineRecords->copy(0, lineRecords->size(), [&](const char* data, size_t size) {
+		for (size_t i = 0; i + sizeof(LineRecord) <= size; i += sizeof(LineRecord)) {
+			LineRecord record;
+			memcpy(&record, data + i, sizeof(LineRecord));
+
+			if (!group.empty() && (record.section != section || record.file != group[0].file || group.size() == LINE_GROUP_ENTRIES))
+				close();
+
+			section = record.section;
+			group.push_back({ record.offset, record.line, record.file });
+		}
+	});
+
+	close();
+	lineSpill->append(out);
+}
+
+
+size_t ObjectWriter::lineGroup(const Section* section, size_t first) {
+	const vector<SourceLine>& lines = section->lines;
+	size_t last = first;
+
+	while (last < lines.size() && last - first < LINE_GROUP_ENTRIES &&
+		   lines[last].file == lines[first].file && lines[last].offset <= section->size)
+		++last;
+
+	return last;
+}
+
+
+void ObjectWriter::appendLines(string& out, uint32_t section, const vector<SourceLine>& lines, size_t first, size_t last) const {
+	uint32_t file = lines[first].file < sourceFiles.size() ? stringOffset(sourceFiles[lines[first].file]) : 0;
+
+	Utils::appendULEB128(out, section);
+	Utils::appendULEB128(out, file);
+	Utils::appendULEB128(out, last - first);
+
+	uint32_t offset = 0;
+	uint32_t line = 0;
+
+	for (size_t j = first; j < last; j++) {
+		Utils::appendULEB128(out, lines[j].offset - offset);
+		Utils::appendSLEB128(out, (int32_t)(lines[j].line - line));
+
+		offset = lines[j].offset;
+		line = lines[j].line;
+	}
+}
+
+
+void ObjectWriter::writeHashIndex(string& out) const {
+	vector<HashEntry> entries;
+
+	for (uint32_t i = 0; i < symbols.size(); i++) {
+		const Symbol* symbol = symbols[i];
+
+		if (symbol->scope == GLOBAL && symbol->defined)
+			entries.push_back({ symbolHash(symbol->name.c_str()), i });
+	}
+
+	HashHeader header;
+	header.entryCount  = entries.size();
+	header.bucketCount = entries.size() / 2 + 1;
+
+	// about 8 bloom bits per symbol, word count is a power of two
+	header.bloomWords = 1;
+	while (header.bloomWords * 8 < entries.size()) header.bloomWords *= 2;
+
+	// the second bit comes from hash bits above those picking the word (as in GNU hash),
+	// at least 6 bits are left for it
+	header.bloomShift = 6;
+	while (header.bloomShift < 26 && (1u << (header.bloomShift - 6)) < header.bloomWords) header.bloomShift++;
+
+	vector<uint64_t> bloom(header.bloomWords, 0);
+	vector<uint32_t> buckets(header.bucketCount + 1, 0);
+
+	for (const HashEntry& entry : entries) {
+		uint64_t& word = bloom[entry.hash / 64 % header.bloomWords];
+
+		word |= (uint64_t)1 << entry.hash % 64;
+		word |= (uint64_t)1 << (entry.hash >> header.bloomShift) % 64;
+
+		++buckets[entry.hash % header.bucketCount + 1];
+	}
+
+	for (uint32_t i = 0; i < header.bucketCount; i++) buckets[i + 1] += buckets[i];
+
+	// entries grouped by bucket, keeping symbol order within a bucket
+	vector<HashEntry> sorted(entries.size());
+	vector<uint32_t> position(buckets.begin(), buckets.end() - 1);
+
+	for (const HashEntry& entry : entries) {
+		HashEntry& target = sorted[position[entry.hash % header.bucketCount]++];
+
+		target.hash   = littleEndian(entry.hash);
+		target.symbol = littleEndian(entry.symbol);
+	}
+
+	for (auto& word : bloom) word = littleEndian(word);
+	for (auto& bucket : buckets) bucket = littleEndian(bucket);
+
+	out.reserve(sizeof(HashHeader) + bloom.size() * sizeof(uint64_t) +
+				buckets.size() * sizeof(uint32_t) + sorted.size() * sizeof(HashEntry));
+
+	HashHeader encoded;
+	encoded.bucketCount = littleEndian(header.bucketCount);
+	encoded.entryCount  = littleEndian(header.entryCount);
+	encoded.bloomWords  = littleEndian(header.bloomWords);
+	encoded.bloomShift  = littleEndian(header.bloomShift);
+
+	out.append((const char*)&encoded, sizeof(HashHeader));
+	out.append((const char*)bloom.data(), bloom.size() * sizeof(uint64_t));
+	out.append((const char*)buckets.data(), buckets.size() * sizeof(uint32_t));
+	out.append((const char*)sorted.data(), sorted.size() * sizeof(HashEntry));
+}
+
+
+ObjectFile::ObjectFile(const uint8_t* t_data, size_t t_size) : data(t_data), size(t_size) {}
+
+
+void ObjectFile::validate(bool checksum) const {
+	if (size < sizeof(ObjectHeader) || memcmp(header().magic, OBJECT_MAGIC, sizeof(OBJECT_MAGIC)))
+		throw ObjectException("Not an object file!");
+
+	if (littleEndian(header().version) != OBJECT_VERSION)
+		throw ObjectException("Unsupported object file version " + to_string(littleEndian(header().version)) + "!");
+
+	if (littleEndian(header().size) != size)
+		throw ObjectException("Object file is truncated!");
+
+	const size_t entrySizes[] = { sizeof(SymbolEntry), sizeof(SectionEntry), 1, 1 };
+
+	for (uint8_t i = 0; i <= STRINGS; i++) {
+		uint64_t offset = littleEndian(header().tables[i].offset);
+		uint64_t entries = littleEndian(header().tables[i].count);
+
+		if (offset % (entrySizes[i] == 1 ? 1 : TABLE_ALIGNMENT) != 0 || offset + entries * entrySizes[i] > size)
+			throw ObjectException("Table out of file bounds!");
+	}
+
+	uint32_t stringsSize = count(STRINGS);
+
+	if (stringsSize == 0 || getString(stringsSize - 1)[0] != '\0')
+		throw ObjectException("Invalid string table!");
+
+	for (uint32_t i = 0; i < count(SYMBOLS); i++) {
+		const SymbolEntry& entry = symbol(i);
+
+		if (littleEndian(entry.name) >= stringsSize ||
+			(littleEndian(entry.section) != NO_INDEX && littleEndian(entry.section) >= count(SECTIONS)))
+			throw ObjectException("Invalid symbol table entry " + to_string(i) + "!");
+	}
+
+	for (uint32_t i = 0; i < count(SECTIONS); i++) {
+		const SectionEntry& entry = section(i);
+
+		if (littleEndian(entry.name) >= stringsSize ||
+			(uint64_t)littleEndian(entry.offset) + littleEndian(entry.stored) > size ||
+			littleEndian(entry.encoding) > LZ ||
+			littleEndian(entry.relocations) > count(RELOCATIONS))
+			throw ObjectException("Invalid section table entry " + to_string(i) + "!");
+
+		RelocationReader reader = relocations(entry);
+		RelocationEntry relocation;
+
+		for (uint32_t j = 0; j < littleEndian(entry.relocationCount); j++) {
+			if (!reader.next(relocation) ||
+				relocation.symbol >= count(SYMBOLS) ||
+				relocation.type > R_386_SUB_PC16 ||
+				relocation.offset >= littleEndian(entry.size))
+				throw ObjectException("Invalid relocation " + to_string(j) + " of section entry " + to_string(i) + "!");
+		}
+	}
+
+	if (littleEndian(header().tables[HASH].count) > 0) {
+		uint64_t offset = littleEndian(header().tables[HASH].offset);
+		uint64_t length = littleEndian(header().tables[HASH].count);
+
+		if (offset % TABLE_ALIGNMENT != 0 || offset + length > size || length < sizeof(HashHeader))
+			throw ObjectException("Hash index out of file bounds!");
+
+		const HashHeader* hash = reinterpret_cast<const HashHeader*>(data + offset);
+
+		uint64_t bucketCount = littleEndian(hash->bucketCount);
+		uint64_t entryCount  = littleEndian(hash->entryCount);
+		uint64_t bloomWords  = littleEndian(hash->bloomWords);
+
+		if (bucketCount == 0 || bloomWords == 0 || littleEndian(hash->bloomShift) >= 32 ||
+			sizeof(HashHeader) + bloomWords * sizeof(uint64_t) +
+			(bucketCount + 1) * sizeof(uint32_t) + entryCount * sizeof(HashEntry) > length)
+			throw ObjectException("Invalid hash index!");
+
+		const uint32_t* buckets = reinterpret_cast<const uint32_t*>(data + offset + sizeof(HashHeader) + bloomWords * sizeof(uint64_t));
+		const HashEntry* entries = reinterpret_cast<const HashEntry*>(buckets + bucketCount + 1);
+
+		for (uint64_t i = 0; i < bucketCount; i++)
+			if (littleEndian(buckets[i]) > littleEndian(buckets[i + 1]) || littleEndian(buckets[i + 1]) > entryCount)
+				throw ObjectException("Invalid hash index!");
+
+		for (uint64_t i = 0; i < entryCount; i++)
+			if (littleEndian(entries[i].symbol) >= count(SYMBOLS))
+				throw ObjectException("Invalid hash index!");
+	}
+
+	if (count(LINES) > 0) {
+		uint64_t offset = littleEndian(header().tables[LINES].offset);
+
+		if (offset + count(LINES) > size)
+			throw ObjectException("Line table out of file bounds!");
+
+		LineReader reader = lines();
+		LineEntry entry;
+		uint32_t entries = 0;
+
+		while (reader.next(entry)) {
+			if (entry.section >= count(SECTIONS) || entry.file >= stringsSize)
+				throw ObjectException("Invalid line table entry " + to_string(entries) + "!");
+
+			++entries;
+		}
+
+		if (!reader.finished())
+			throw ObjectException("Invalid line table!");
+	}
+
+	if (count(STAMP) > 0) {
+		uint64_t offset = littleEndian(header().tables[STAMP].offset);
+
+		if (offset % TABLE_ALIGNMENT != 0 || offset + (uint64_t)count(STAMP) * sizeof(StampEntry) > size)
+			throw ObjectException("Stamp out of file bounds!");
+
+		for (const StampEntry& entry : stamp())
+			if (littleEndian(entry.file) >= stringsSize)
+				throw ObjectException("Invalid stamp entry!");
+	}
+
+	if (checksum) {
+		const size_t position = offsetof(ObjectHeader, checksum);
+		const uint8_t zero[sizeof(uint32_t)] = { 0 };
+
+		uint32_t crc = Utils::crc32(data, position);
+		crc = Utils::crc32(zero, sizeof(zero), crc);
+		crc = Utils::crc32(data + position + sizeof(zero), size - position - sizeof(zero), crc);
+
+		if (crc != littleEndian(header().checksum))
+			throw ObjectException("Checksum mismatch!");
+	}
+}
+
+
+void ObjectFile::extract(const SectionEntry& section, uint8_t* out) const {
+	if (littleEndian(section.encoding) != LZ) {
+		memcpy(out, contents(section), littleEndian(section.stored));
+		return;
+	}
+
+	if (!Utils::decompressLZ(contents(section), littleEndian(section.stored), out, littleEndian(section.size)))
+		throw ObjectException("Corrupted contents of section " + string(getString(section.name)) + "!");
+}
+
+
+uint32_t ObjectFile::findSymbol(const char* name) const {
+	uint32_t length = littleEndian(header().tables[HASH].count);
+
+	if (length == 0) {
+		for (uint32_t i = 0; i < count(SYMBOLS); i++)
+			if (!strcmp(getString(symbol(i).name), name)) return i;
+
+		return NO_INDEX;
+	}
+
+	const uint8_t* table = data + littleEndian(header().tables[HASH].offset);
+	const HashHeader* hash = reinterpret_cast<const HashHeader*>(table);
+
+	uint32_t bucketCount = littleEndian(hash->bucketCount);
+	uint32_t bloomWords  = littleEndian(hash->bloomWords);
+	uint32_t bloomShift  = littleEndian(hash->bloomShift);
+
+	const uint64_t* bloom = reinterpret_cast<const uint64_t*>(table + sizeof(HashHeader));
+	const uint32_t* buckets = reinterpret_cast<const uint32_t*>(bloom + bloomWords);
+	const HashEntry* entries = reinterpret_cast<const HashEntry*>(buckets + bucketCount + 1);
+
+	uint32_t value = symbolHash(name);
+	uint64_t word = littleEndian(bloom[value / 64 % bloomWords]);
+
+	if (!(word >> value % 64 & 1) || !(word >> (value >> bloomShift) % 64 & 1))
+		return NO_INDEX;
+
+	uint32_t bucket = value % bucketCount;
+
+	for (uint32_t i = littleEndian(buckets[bucket]); i < littleEndian(buckets[bucket + 1]); i++) {
+		if (littleEndian(entries[i].hash) != value) continue;
+
+		uint32_t index = littleEndian(entries[i].symbol);
+		if (!strcmp(getString(symbol(index).name), name)) return index;
+	}
+
+	return NO_INDEX;
+}
+
+
+MappedObjectFile::MappedObjectFile(const string& file) : ObjectFile(nullptr, 0) {
+	int descriptor = open(file.c_str(), O_RDONLY);
+
+	if (descriptor < 0)
+		throw ObjectException("Can't open file " + file + "!");
+
+	struct stat status;
+
+	if (fstat(descriptor, &status) < 0 || status.st_size < (off_t)sizeof(ObjectHeader)) {
+		close(descriptor);
+		throw ObjectException("File " + file + " is not an object file!");
+	}
+
+	void* mapping = mmap(nullptr, status.st_size, PROT_READ, MAP_PRIVATE, descriptor, 0);
+	close(descriptor);
+
+	if (mapping == MAP_FAILED)
+		throw ObjectException("Can't map file " + file + "!");
+
+	data = static_cast<const uint8_t*>(mapping);
+	size = status.st_size;
+}
+
+
+MappedObjectFile::~MappedObjectFile() {
+	munmap(const_cast<uint8_t*>(data), size);
+}
+
+
+bool RelocationReader::next(RelocationEntry& entry) {
+	uint32_t delta, info;
+
+	if (remaining == 0 ||
+		!Utils::readULEB128(data, limit, delta) ||
+		!Utils::readULEB128(data, limit, info))
+		return false;
+
+	--remaining;
+	offset += delta;
+
+	entry.symbol = info >> RELOCATION_TYPE_BITS;
+	entry.offset = offset;
+	entry.type   = (RelocationType)(info & ((1 << RELOCATION_TYPE_BITS) - 1));
+
+	return true;
+}
+
+
+bool LineReader::next(LineEntry& entry) {
+	while (remaining == 0) {
+		if (data >= limit ||
+			!Utils::readULEB128(data, limit, section) ||
+			!Utils::readULEB128(data, limit, file) ||
+			!Utils::readULEB128(data, limit, remaining))
+			return false;
+
+		offset = 0;
+		line = 0;
+	}
+
+	uint32_t delta;
+	int32_t lineDelta;
+
+	if (!Utils::readULEB128(data, limit, delta) || !Utils::readSLEB128(data, limit, lineDelta))
+		return false;
+
+	--remaining;
+	offset += delta;
+	line += lineDelta;
+
+	entry.section = section;
+	entry.file    = file;
+	entry.offset  = offset;
+	entry.line    = line;
+
+	return true;
+}
\ No newline at end of file
@@ -0,0 +1,585 @@
+#ifndef _OBJECT_H_
+#define _OBJECT_H_
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <utility>
+#include <ostream>
+#include <functional>
+#include <unordered_map>
+
+#include "types.h"
+#include "symbol.h"
+#include "section.h"
+#include "relocation.h"
+#include "spill.h"
+
+// Relocatable object file layout
+//
+//   header | symbol entries | section entries | relocations | hash index | line table | stamp | string table | section contents
+//
+// All fields are little-endian and fixed width regardless of the host, so
+// the file can be mapped into memory and any entry indexed directly:
+// entry i of a table lives at tables[table].offset + i * sizeof(entry).
+// Names are NUL-terminated strings in the string table, referenced by
+// offset (offset 0 is the empty string). A name that ends another one
+// points into its tail instead of being stored again. Section contents
+// start at OBJECT_ALIGNMENT boundaries, stored as they are or compressed
+// (Utils::compressLZ) when the section entry says so.
+//
+// Relocations are packed per target section, sorted by offset: each one is
+// ULEB128(offset - previous offset) followed by ULEB128(symbol << 3 | type).
+// A section entry locates its group inside the relocation table, so applying
+// them is a linear sweep over the section.
+//
+// The line table maps section offsets to source lines. It is a sequence of
+// groups: ULEB128(section), ULEB128(file name string), ULEB128(count), then
+// count pairs of ULEB128(offset delta), SLEB128(line delta), both relative
+// to the previous pair of the group (starting from 0). A line covers the
+// section from its offset up to the next entry. Groups hold at most
+// LINE_GROUP_ENTRIES pairs, so a writer buffers at most that many entries.
+//
+// The optional stamp records what the object was assembled from: an entry
+// with an empty name holds a hash of the options, the others a hash of the
+// contents of each source and .incbin file, named by path.
+
+constexpr uint8_t  OBJECT_MAGIC[] = { 0x7F, 'S', 'O', 'F' };
+constexpr uint16_t OBJECT_VERSION = 3;
+
+constexpr uint32_t OBJECT_ALIGNMENT = 16;
+constexpr uint32_t TABLE_ALIGNMENT  = 8;
+
+// entry referencing no symbol/section (undefined symbols)
+constexpr uint32_t NO_INDEX = 0xFFFFFFFF;
+
+constexpr uint8_t RELOCATION_TYPE_BITS = 3;
+
+constexpr uint32_t LINE_GROUP_ENTRIES = 4096;
+
+// header slots, unused slots are zero and reserved for future tables
+enum ObjectTable : uint8_t { SYMBOLS, SECTIONS, RELOCATIONS, STRINGS, HASH, LINES, STAMP };
+constexpr uint8_t OBJECT_TABLES = 8;
+
+// how section contents are stored in the file
+enum SectionEncoding : uint16_t { STORED, LZ };
+
+
+struct ObjectHeader {
+	uint8_t  magic[4];
+	uint16_t version;
+	uint16_t flags;
+
+	// size of the whole file
+	uint32_t size;
+	// CRC-32 of the whole file, computed with this field set to zero
+	uint32_t checksum;
+
+	// count is the number of entries for fixed-size tables, number of bytes otherwise
+	struct {
+		uint32_t offset;
+		uint32_t count;
+	} tables[OBJECT_TABLES];
+};
+
+
+struct SymbolEntry {
+	uint32_t name;
+	uint32_t section;
+	int32_t  value;
+
+	uint8_t scope;
+	uint8_t type;
+	uint8_t defined;
+	uint8_t reserved;
+};
+
+
+struct SectionEntry {
+	uint32_t name;
+	uint32_t symbol;
+
+	// bit i set for flag i of WAXMSILGTE
+	uint16_t flags;
+	uint16_t encoding;
+
+	uint32_t size;
+
+	// location and size of contents in the file (no contents for BSS),
+	// size of the compressed data for LZ encoded sections
+	uint32_t offset;
+	uint32_t stored;
+
+	// byte offset of packed relocations inside the relocation table and their number
+	uint32_t relocations;
+	uint32_t relocationCount;
+};
+
+
+// decoded relocation
+struct RelocationEntry {
+	uint32_t symbol;
+	uint32_t offset;
+
+	RelocationType type;
+};
+
+
+// decoded line table entry
+struct LineEntry {
+	uint32_t section;
+	uint32_t file;
+	uint32_t offset;
+	uint32_t line;
+};
+
+
+struct StampEntry {
+	uint32_t file;
+	uint32_t reserved;
+
+	// Utils::hash64 of the file contents
+	uint64_t hash;
+};
+
+
+// Optional index over names of defined global symbols (count is the size in bytes)
+//
+//   HashHeader | uint64_t bloom[bloomWords] | uint32_t buckets[bucketCount + 1] | HashEntry entries[entryCount]
+//
+// A name with hash h can only be present if bits (h % 64) and ((h >> bloomShift) % 64)
+// are both set in bloom word (h / 64) % bloomWords. Entries of bucket h % bucketCount
+// are entries[buckets[b]] .. entries[buckets[b + 1] - 1]. The writer picks bloomShift
+// so the second bit does not depend on the bits selecting the word.
+struct HashHeader {
+	uint32_t bucketCount;
+	uint32_t entryCount;
+	uint32_t bloomWords;
+	uint32_t bloomShift;
+};
+
+
+struct HashEntry {
+	uint32_t hash;
+	uint32_t symbol;
+};
+
+
+static_assert(sizeof(ObjectHeader)    == 80, "Unexpected object header size!");
+static_assert(sizeof(SymbolEntry)     == 16, "Unexpected symbol entry size!");
+static_assert(sizeof(SectionEntry)    == 32, "Unexpected section entry size!");
+static_assert(sizeof(HashHeader)      == 16, "Unexpected hash header size!");
+static_assert(sizeof(HashEntry)       ==  8, "Unexpected hash entry size!");
+static_assert(sizeof(StampEntry)      == 16, "Unexpected stamp entry size!");
+
+
+// hash of symbol names used by the hash index (same as .gnu.hash)
+inline uint32_t symbolHash(const char* name) {
+	uint32_t hash = 5381;
+
+	while (*name) hash = hash * 33 + (uint8_t)*name++;
+
+	return hash;
+}
+
+
+// conversion between host and file byte order (same in both directions)
+inline uint16_t littleEndian(uint16_t value) {
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+	return __builtin_bswap16(value);
+#else
+	return value;
+#endif
+}
+
+inline uint32_t littleEndian(uint32_t value) {
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+	return __builtin_bswap32(value);
+#else
+	return value;
+#endif
+}
+
+inline int32_t littleEndian(int32_t value) {
+	return (int32_t)littleEndian((uint32_t)value);
+}
+
+inline uint64_t littleEndian(uint64_t value) {
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+	return __builtin_bswap64(value);
+#else
+	return value;
+#endif
+}
+
+
+class ObjectWriter {
+public:
+	ObjectWriter(const std::unordered_map<std::string, Symbol*>& symbolTable,
+				 const std::unordered_map<std::string, Section*>& sectionTable,
+				 const std::vector<Relocation*>& relocationTable);
+
+	// emit the symbol hash index (HASH table)
+	void setHashIndex(bool enabled) {
+		hashIndex = enabled;
+	}
+
+	// compress contents of data sections (allocated, not executable)
+	void setCompression(bool enabled) {
+		compression = enabled;
+	}
+
+	// names of the files SourceLine::file refers to
+	void setSourceFiles(const std::vector<std::string>& files) {
+		sourceFiles = files;
+	}
+
+	// hashes the STAMP table records, by file name (empty for the options)
+	void setStamp(const std::vector<std::pair<std::string, uint64_t>>& hashes) {
+		stamp = hashes;
+	}
+
+	// writes the complete object file into the output buffer
+	void write(std::string& out);
+
+	// writes the object file to the stream piece by piece, no image of it is built
+	void write(std::ostream& out);
+
+	typedef std::function<void(const char*, size_t)> Sink;
+
+	// Streamed assembly: finished parts of the sections are moved to temporary
+	// files while the second pass produces them, in order of the section entries.
+
+	// moves the contents held by the section to the end of its spilled contents
+	void spillContents(Section* section);
+
+	// packs all relocations of the relocation table, which belong to the section
+	void spillRelocations(const Section* section);
+
+	// moves the entries at the front of the section's lines that can no longer change,
+	// returns their number for the caller to remove; they are grouped when written
+	size_t spillLines(const Section* section, bool finished);
+
+	// passes the spilled contents of the section to the sink
+	void spilledContents(const Section* section, const Sink& sink) const;
+private:
+	// passes the object to the sink in file order, padding included
+	void emit(const Sink& sink);
+
+	// symbol entries in order, again when the owner added symbols since
+	void collectSymbols();
+
+	// creates the temporary files on the first spill
+	void startSpill();
+
+	void addString(const std::string& value);
+
+	// builds the string table, strings that end another one share its tail
+	void layoutStrings();
+
+	uint32_t stringOffset(const std::string& value) const;
+
+	void writeRelocations(std::string& out, std::vector<SectionEntry>& sectionEntries) const;
+
+	void writeHashIndex(std::string& out) const;
+
+	void writeLines(std::string& out) const;
+
+	// groups the spilled line entries into the spilled line table
+	void writeSpilledLines();
+
+	// sorts the relocations of one section by offset and packs them after previous
+	void appendRelocations(std::string& out, std::vector<const Relocation*>& group, uint32_t& previous) const;
+
+	// end of the line group starting at first: a run of entries from one file,
+	// at most LINE_GROUP_ENTRIES long, stopping at entries past the section
+	static size_t lineGroup(const Section* section, size_t first);
+
+	void appendLines(std::string& out, uint32_t section, const std::vector<SourceLine>& lines, size_t first, size_t last) const;
+
+	uint32_t symbolIndex(const std::string& name) const;
+	uint32_t sectionIndex(const std::string& name) const;
+
+	const std::unordered_map<std::string, Symbol*>& symbolTable;
+
+	std::vector<const Symbol*>  symbols;
+	std::vector<const Section*> sections;
+
+	const std::vector<Relocation*>& relocations;
+
+	std::unordered_map<std::string, uint32_t> symbolIndices;
+	std::unordered_map<std::string, uint32_t> sectionIndices;
+
+	std::string strings;
+	std::unordered_map<std::string, uint32_t> stringOffsets;
+
+	std::vector<std::string> sourceFiles;
+
+	std::vector<std::pair<std::string, uint64_t>> stamp;
+
+	bool hashIndex;
+	bool compression;
+
+	// spilled line entry
+	struct LineRecord {
+		uint32_t section;
+		uint32_t offset;
+		uint32_t line;
+		uint32_t file;
+	};
+
+	// where the parts of a section went while streaming
+	struct SpilledSection {
+		uint64_t contents;
+
+		uint32_t relocations;
+		uint32_t relocationBytes;
+		uint32_t relocationCount;
+		uint32_t previousRelocation;
+	};
+
+	std::unique_ptr<SpillFile> contentsSpill;
+	std::unique_ptr<SpillFile> relocationSpill;
+	std::unique_ptr<SpillFile> lineRecords;
+	std::unique_ptr<SpillFile> lineSpill;
+
+	std::vector<SpilledSection> spilledSections;
+};
+
+
+// sequential decoder over the packed relocations of one section,
+// also usable as a range: for (const RelocationEntry& entry : reader)
+class RelocationReader {
+public:
+	class Iterator {
+	public:
+		Iterator(RelocationReader* t_reader) : reader(t_reader) {
+			++*this;
+		}
+
+		const RelocationEntry& operator*() const {
+			return entry;
+		}
+
+		const RelocationEntry* operator->() const {
+			return &entry;
+		}
+
+		Iterator& operator++() {
+			if (reader && !reader->next(entry)) reader = nullptr;
+			return *this;
+		}
+
+		bool operator!=(const Iterator& other) const {
+			return reader != other.reader;
+		}
+	private:
+		RelocationReader* reader;
+		RelocationEntry entry;
+	};
+
+	RelocationReader(const uint8_t* t_data, const uint8_t* t_end, uint32_t t_count) :
+		data(t_data), limit(t_end), remaining(t_count), offset(0) {}
+
+	// decodes the next relocation, false when there are no more (or data is malformed)
+	bool next(RelocationEntry& entry);
+
+	Iterator begin() {
+		return Iterator(this);
+	}
+
+	Iterator end() {
+		return Iterator(nullptr);
+	}
+private:
+	const uint8_t* data;
+	const uint8_t* limit;
+
+	uint32_t remaining;
+	uint32_t offset;
+};
+
+
+// sequential decoder over the line table, same usage as RelocationReader
+class LineReader {
+public:
+	class Iterator {
+	public:
+		Iterator(LineReader* t_reader) : reader(t_reader) {
+			++*this;
+		}
+
+		const LineEntry& operator*() const {
+			return entry;
+		}
+
+		const LineEntry* operator->() const {
+			return &entry;
+		}
+
+		Iterator& operator++() {
+			if (reader && !reader->next(entry)) reader = nullptr;
+			return *this;
+		}
+
+		bool operator!=(const Iterator& other) const {
+			return reader != other.reader;
+		}
+	private:
+		LineReader* reader;
+		LineEntry entry;
+	};
+
+	LineReader(const uint8_t* t_data, const uint8_t* t_end) :
+		data(t_data), limit(t_end), section(0), file(0), remaining(0), offset(0), line(0) {}
+
+	// decodes the next entry, false at the end of the table (or if data is malformed)
+	bool next(LineEntry& entry);
+
+	// whole table consumed, i.e. next() did not stop on malformed data
+	bool finished() const {
+		return data == limit && remaining == 0;
+	}
+
+	Iterator begin() {
+		return Iterator(this);
+	}
+
+	Iterator end() {
+		return Iterator(nullptr);
+	}
+private:
+	const uint8_t* data;
+	const uint8_t* limit;
+
+	uint32_t section;
+	uint32_t file;
+	uint32_t remaining;
+
+	uint32_t offset;
+	uint32_t line;
+};
+
+
+// contiguous fixed-size table inside the image, entries are not copied
+template <typename T>
+class TableView {
+public:
+	TableView(const T* t_first, uint32_t t_count) : first(t_first), last(t_first + t_count) {}
+
+	const T* begin() const {
+		return first;
+	}
+
+	const T* end() const {
+		return last;
+	}
+
+	uint32_t size() const {
+		return last - first;
+	}
+
+	const T& operator[](uint32_t index) const {
+		return first[index];
+	}
+private:
+	const T* first;
+	const T* last;
+};
+
+
+// read-only view of an object file image (e.g. mapped into memory)
+class ObjectFile {
+public:
+	ObjectFile(const uint8_t* t_data, size_t t_size);
+
+	virtual ~ObjectFile() = default;
+
+	// checks magic, version, table bounds and (optionally) the checksum
+	void validate(bool checksum = true) const;
+
+	const ObjectHeader& header() const {
+		return *reinterpret_cast<const ObjectHeader*>(data);
+	}
+
+	uint32_t count(ObjectTable table) const {
+		return littleEndian(header().tables[table].count);
+	}
+
+	const SymbolEntry& symbol(uint32_t index) const {
+		return entry<SymbolEntry>(SYMBOLS, index);
+	}
+
+	const SectionEntry& section(uint32_t index) const {
+		return entry<SectionEntry>(SECTIONS, index);
+	}
+
+	TableView<SymbolEntry> symbols() const {
+		return TableView<SymbolEntry>(&entry<SymbolEntry>(SYMBOLS, 0), count(SYMBOLS));
+	}
+
+	TableView<SectionEntry> sections() const {
+		return TableView<SectionEntry>(&entry<SectionEntry>(SECTIONS, 0), count(SECTIONS));
+	}
+
+	TableView<StampEntry> stamp() const {
+		return TableView<StampEntry>(&entry<StampEntry>(STAMP, 0), count(STAMP));
+	}
+
+	RelocationReader relocations(const SectionEntry& section) const {
+		const uint8_t* table = data + littleEndian(header().tables[RELOCATIONS].offset);
+
+		return RelocationReader(table + littleEndian(section.relocations),
+								table + count(RELOCATIONS),
+								littleEndian(section.relocationCount));
+	}
+
+	LineReader lines() const {
+		const uint8_t* table = data + littleEndian(header().tables[LINES].offset);
+
+		return LineReader(table, table + count(LINES));
+	}
+
+	const char* getString(uint32_t offset) const {
+		return reinterpret_cast<const char*>(data + littleEndian(header().tables[STRINGS].offset) + littleEndian(offset));
+	}
+
+	// contents as stored in the file, see extract() for LZ encoded sections
+	const uint8_t* contents(const SectionEntry& section) const {
+		return data + littleEndian(section.offset);
+	}
+
+	// number of bytes extract() produces
+	uint32_t contentSize(const SectionEntry& section) const {
+		return littleEndian(section.encoding) == LZ ? littleEndian(section.size) : littleEndian(section.stored);
+	}
+
+	// copies (decompressing if needed) contents into out, which holds contentSize() bytes
+	void extract(const SectionEntry& section, uint8_t* out) const;
+
+	// index of the symbol with the given name, or NO_INDEX;
+	// only defined global symbols are found through the hash index when present
+	uint32_t findSymbol(const char* name) const;
+protected:
+	template <typename T>
+	const T& entry(ObjectTable table, uint32_t index) const {
+		return reinterpret_cast<const T*>(data + littleEndian(header().tables[table].offset))[index];
+	}
+
+	const uint8_t* data;
+	size_t size;
+};
+
+
+// object file mapped read-only into memory for the lifetime of the object
+class MappedObjectFile : public ObjectFile {
+public:
+	MappedObjectFile(const std::string& file);
+
+	~MappedObjectFile();
+
+	MappedObjectFile(const MappedObjectFile&) = delete;
+	MappedObjectFile& operator=(const MappedObjectFile&) = delete;
+};
+
+#endif
\ No newline at end of file
@@ -12,20 +12,22 @@ public:
 
 	Relocation(const std::string& t_symbol,
 			   const std::string& t_section,
-			   int16_t t_offset,
+			   uint32_t t_offset,
 			   RelocationType t_type);
 
-	void serialize(std::ostream& out) const;
-
-	void deserialize(std::istream& in);
+	// appends a listing row (without line break) to the output buffer
+	void format(std::string& out) const;
 
 	friend class Loader;
+	friend class ObjectWriter;
+	friend class ImageWriter;
+	friend class Assembler;
 	friend std::ostream& operator<<(std::ostream& out, const Relocation& relocation);
 private:
 	std::string symbol;
 
 	std::string section;
-	int16_t offset;
+	uint32_t offset;
 
 	RelocationType type;
 };
@@ -0,0 +1,47 @@
+#ifndef _RINGBUFFER_H_
+#define _RINGBUFFER_H_
+
+#include <atomic>
+#include <cstddef>
+
+// Bounded queue of one producer and one consumer thread without locks: the
+// producer only stores tail and the consumer only head, each acquires the
+// other's index. One of the N slots stays free to tell full from empty.
+template <typename T, size_t N>
+class RingBuffer {
+public:
+	RingBuffer() : head(0), tail(0) {}
+
+	// producer, false when full
+	bool push(const T& value) {
+		size_t current = tail.load(std::memory_order_relaxed);
+		size_t next = (current + 1) % N;
+
+		if (next == head.load(std::memory_order_acquire)) return false;
+
+		slots[current] = value;
+		tail.store(next, std::memory_order_release);
+
+		return true;
+	}
+
+	// consumer, false when empty
+	bool pop(T& value) {
+		size_t current = head.load(std::memory_order_relaxed);
+
+		if (current == tail.load(std::memory_order_acquire)) return false;
+
+		value = slots[current];
+		head.store((current + 1) % N, std::memory_order_release);
+
+		return true;
+	}
+private:
+	T slots[N];
+
+	// on cache lines of their own, the threads write one each
+	alignas(64) std::atomic<size_t> head;
+	alignas(64) std::atomic<size_t> tail;
+};
+
+#endif
\ No newline at end of file
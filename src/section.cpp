@@ -1,115 +1,91 @@
 #include <string>
 #include <vector>
 #include <iostream>
-#include <sstream>
-#include <iomanip>
-#include <algorithm>
 
 #include "types.h"
+#include "utils.h"
 #include "section.h"
 
 
-uint16_t Section::lastSectionTableEntry = 0;
-
-
 Section::Section() :
 	sectionTableEntry(0),
-	symbolTableEntry(0), size(0) {}
+	symbolTableEntry(0), size(0), spilled(0) {}
 
 
-Section::Section(const std::string& t_name, uint16_t t_entry, const std::string& t_flags) :
-	sectionTableEntry(lastSectionTableEntry++),
-	name(t_name), symbolTableEntry(t_entry), flags(t_flags), size(0) {}
+Section::Section(const std::string& t_name, uint32_t t_entry, uint32_t t_symbolEntry, const std::string& t_flags) :
+	sectionTableEntry(t_entry),
+	name(t_name), symbolTableEntry(t_symbolEntry), flags(t_flags), size(0), spilled(0) {}
 
 
-void Section::write(int position, std::vector<uint8_t>& bytes) {
+void Section::write(uint32_t position, std::vector<uint8_t>& bytes) {
 	auto begin = this->bytes.begin();
-	this->bytes.insert(begin + position, bytes.begin(), bytes.end());
-}
+	this->bytes.insert(begin + (position - spilled), bytes.begin(), bytes.end());
 
-
-void Section::writeValue(int position, size_t count, uint8_t value) {
-	auto begin = bytes.begin();
-	bytes.insert(begin + position, count, value);
+	if (spilled + this->bytes.size() > size) size = spilled + this->bytes.size();
 }
 
 
-std::string Section::getBytes() const {
-	std::stringstream out;
-	const uint8_t bytesPerLine = 16;
+void Section::writeValue(uint32_t position, size_t count, uint8_t value) {
+	auto begin = bytes.begin();
+	bytes.insert(begin + (position - spilled), count, value);
 
-	for (int i = 0; i < size; i++) {
-		if (i > 0 && i % bytesPerLine == 0) out << std::endl;
+	if (spilled + bytes.size() > size) size = spilled + bytes.size();
+}
 
-		out << std::right
-			<< std::setfill('0')
-			<< std::setw(2)
-			<< std::hex << (uint32_t)bytes[i] << ' ';
-	}
-	out << std::endl;
 
-	std::string result = out.str();
-	std::transform(result.begin(), result.end(), result.begin(), ::toupper);
+uint8_t* Section::allocate(uint32_t position, size_t count) {
+	writeValue(position, count, 0);
 
-	return result;
+	return bytes.data() + (position - spilled);
 }
 
 
-void Section::serialize(std::ostream& out) const {
-	out.write((char*)& sectionTableEntry, sizeof(uint16_t));
-
-	size_t size = name.size();
-	out.write((char*)& size, sizeof(size_t));
-	out.write(&name[0], size);
+void Section::addLine(uint32_t offset, uint32_t line, uint32_t file) {
+	if (!lines.empty()) {
+		SourceLine& last = lines.back();
 
-	size = flags.size();
-	out.write((char*)& size, sizeof(size_t));
-	out.write(&flags[0], size);
+		// previous line produced nothing
+		if (last.offset == offset) {
+			last.line = line;
+			last.file = file;
 
-	out.write((char*)& symbolTableEntry, sizeof(uint16_t));
+			if (lines.size() > 1 && lines[lines.size() - 2].line == line && lines[lines.size() - 2].file == file)
+				lines.pop_back();
+			return;
+		}
 
-	out.write((char*)& this->size, sizeof(size_t));
+		if (last.line == line && last.file == file) return;
+	}
 
-	for (const uint8_t& byte : bytes)
-		out.write((char*)& byte, sizeof(uint8_t));
+	lines.push_back({ offset, line, file });
 }
 
 
-void Section::deserialize(std::istream& in) {
-	in.read((char*)& sectionTableEntry, sizeof(uint16_t));
+std::string Section::getBytes() const {
+	std::string result;
+	formatBytes(result);
 
-	size_t size;
-	in.read((char*)& size, sizeof(size_t));
-	char* temp = new char[size];
-	in.read(temp, size);
-	name.assign(temp, size);
-	delete[] temp;
+	return result;
+}
 
-	in.read((char*)& size, sizeof(size_t));
-	temp = new char[size];
-	in.read(temp, size);
-	flags.assign(temp, size);
-	delete[] temp;
 
-	in.read((char*)& symbolTableEntry, sizeof(uint16_t));
+void Section::formatBytes(std::string& out) const {
+	Utils::appendHexDump(out, bytes.data(), size);
+}
 
-	in.read((char*)& this->size, sizeof(size_t));
 
-	for (int i = 0; i < this->size; i++) {
-		uint8_t byte;
-		in.read((char*)& byte, sizeof(uint8_t));
-		bytes.push_back(byte);
-	}
+void Section::format(std::string& out) const {
+	Utils::appendColumn(out, sectionTableEntry);
+	Utils::appendColumn(out, name);
+	Utils::appendColumn(out, size);
+	Utils::appendColumn(out, flags);
+	Utils::appendColumn(out, symbolTableEntry);
 }
 
 
 std::ostream& operator<<(std::ostream& out, const Section& section) {
-	out << std::left
-		<< std::setw(WIDTH) << section.sectionTableEntry
-		<< std::setw(WIDTH) << section.name
-		<< std::setw(WIDTH) << section.size
-		<< std::setw(WIDTH) << section.flags
-		<< std::setw(WIDTH) << section.symbolTableEntry;
-
-	return out;
+	std::string row;
+	section.format(row);
+
+	return out << row;
 }
\ No newline at end of file
@@ -5,39 +5,62 @@
 #include <vector>
 #include <iostream>
 
+// source position of the code/data starting at offset (up to the next entry)
+struct SourceLine {
+	uint32_t offset;
+	uint32_t line;
+	uint32_t file;
+};
+
+
 class Section {
 public:
 	Section();
 
-	Section(const std::string& t_name, uint16_t t_entry, const std::string& t_flags);
+	// entry numbers of the section and its symbol are given by the owner of the tables
+	Section(const std::string& t_name, uint32_t t_entry, uint32_t t_symbolEntry, const std::string& t_flags);
 
 	std::string getName() const {
 		return this->name;
 	}
 
-	void write(int position, std::vector<uint8_t>& bytes);
-	void writeValue(int position, size_t count, uint8_t value);
+	void write(uint32_t position, std::vector<uint8_t>& bytes);
+	void writeValue(uint32_t position, size_t count, uint8_t value);
+
+	// inserts count bytes at position for the caller to fill in place
+	uint8_t* allocate(uint32_t position, size_t count);
+
+	void addLine(uint32_t offset, uint32_t line, uint32_t file);
 
 	std::string getBytes() const;
 
-	void serialize(std::ostream& out) const;
+	// appends the hex dump of section contents to the output buffer
+	void formatBytes(std::string& out) const;
 
-	void deserialize(std::istream& in);
+	// appends a listing row (without line break) to the output buffer
+	void format(std::string& out) const;
 
 	friend class Loader;
+	friend class ObjectWriter;
+	friend class ImageWriter;
 	friend class Assembler;
 	friend std::ostream& operator<<(std::ostream& out, const Section& section);
 private:
-	static uint16_t lastSectionTableEntry;
-
-	uint16_t sectionTableEntry;
+	uint32_t sectionTableEntry;
 
 	std::string name;
 	std::string flags;
-	uint16_t symbolTableEntry;
+	uint32_t symbolTableEntry;
 
 	size_t size;
+
+	// contents from offset spilled on, the ones before it were handed to the
+	// object writer (streamed assembly)
 	std::vector<uint8_t> bytes;
+	size_t spilled;
+
+	// ordered by offset
+	std::vector<SourceLine> lines;
 };
 
 #endif
\ No newline at end of file
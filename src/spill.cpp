@@ -0,0 +1,52 @@
+#include <cstdio>
+#include <string>
+#include <vector>
+#include <algorithm>
+
+#include "exceptions.h"
+#include "spill.h"
+
+using namespace std;
+
+
+SpillFile::SpillFile() : file(tmpfile()), length(0) {
+	if (!file) throw AssemblingException("Can't create temporary file!");
+}
+
+
+SpillFile::~SpillFile() {
+	fclose(file);
+}
+
+
+uint64_t SpillFile::append(const void* data, size_t count) {
+	uint64_t position = length;
+
+	// reads move the file position, appends always go to the end
+	if (count > 0 && (fseeko(file, position, SEEK_SET) != 0 || fwrite(data, 1, count, file) != count))
+		throw AssemblingException("Can't write temporary file!");
+
+	length += count;
+
+	return position;
+}
+
+
+void SpillFile::read(uint64_t position, void* out, size_t count) const {
+	if (count > 0 && (fseeko(file, position, SEEK_SET) != 0 || fread(out, 1, count, file) != count))
+		throw AssemblingException("Can't read temporary file!");
+}
+
+
+void SpillFile::copy(uint64_t position, uint64_t count, const Sink& sink) const {
+	vector<char> piece(min<uint64_t>(count, SPILL_PIECE));
+
+	for (uint64_t done = 0; done < count;) {
+		size_t length = min<uint64_t>(count - done, SPILL_PIECE);
+
+		read(position + done, piece.data(), length);
+		sink(piece.data(), length);
+
+		done += length;
+	}
+}
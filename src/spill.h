@@ -0,0 +1,47 @@
+#ifndef _SPILL_H_
+#define _SPILL_H_
+
+#include <cstdio>
+#include <cstdint>
+#include <string>
+#include <functional>
+
+// Append-only temporary file holding output that is produced long before it
+// is written (streamed assembly). It is removed when closed.
+class SpillFile {
+public:
+	typedef std::function<void(const char*, size_t)> Sink;
+
+	SpillFile();
+
+	~SpillFile();
+
+	SpillFile(const SpillFile&) = delete;
+	SpillFile& operator=(const SpillFile&) = delete;
+
+	uint64_t size() const {
+		return length;
+	}
+
+	// appends the data, returns its position in the file
+	uint64_t append(const void* data, size_t count);
+
+	uint64_t append(const std::string& data) {
+		return append(data.data(), data.size());
+	}
+
+	// copies count bytes from position on into out
+	void read(uint64_t position, void* out, size_t count) const;
+
+	// passes count bytes from position on to the sink, in pieces of
+	// SPILL_PIECE bytes but the last
+	void copy(uint64_t position, uint64_t count, const Sink& sink) const;
+private:
+	FILE* file;
+	uint64_t length;
+};
+
+// a multiple of 16, so hex dumps of the pieces line up
+constexpr size_t SPILL_PIECE = 64 * 1024;
+
+#endif
@@ -1,30 +1,28 @@
 #include <string>
 #include <iostream>
-#include <iomanip>
 
 #include "types.h"
+#include "utils.h"
 #include "symbol.h"
 
 
-uint16_t Symbol::lastSymbolTableEntry = 0;
-
-
 Symbol::Symbol() :
 	symbolTableEntry(0), value(0),
 	scope(LOCAL), type(SymbolType::UNRESOLVED), defined(false) {}
 
 
 Symbol::Symbol(const std::string& t_name,
+			   uint32_t t_entry,
 			   const std::string& t_section,
-			   int16_t t_value,
+			   int32_t t_value,
 			   ScopeType t_scope,
 			   SymbolType t_type,
 			   bool t_defined) :
-	symbolTableEntry(lastSymbolTableEntry++),
+	symbolTableEntry(t_entry),
 	name(t_name), section(t_section), value(t_value), scope(t_scope), type(t_type), defined(t_defined) {}
 
 
-void Symbol::setData(const std::string& section, int16_t value, ScopeType scope, SymbolType type, bool defined) {
+void Symbol::setData(const std::string& section, int32_t value, ScopeType scope, SymbolType type, bool defined) {
 	this->section = section;
 	this->value = value;
 	this->scope = scope;
@@ -33,64 +31,24 @@ void Symbol::setData(const std::string& section, int16_t value, ScopeType scope,
 }
 
 
-void Symbol::serialize(std::ostream& out) const {
-	out.write((char*)& symbolTableEntry, sizeof(uint16_t));
-
-	size_t size = name.size();
-	out.write((char*)& size, sizeof(size_t));
-	out.write(&name[0], size);
-
-	size = section.size();
-	out.write((char*)& size, sizeof(size_t));
-	out.write(&section[0], size);
-
-	out.write((char*)& value, sizeof(int16_t));
-
-	uint8_t enumType = scope;
-	out.write((char*)& enumType, sizeof(uint8_t));
-	enumType = (uint8_t)type;
-	out.write((char*)& enumType, sizeof(uint8_t));
-
-	out.write((char*)& defined, sizeof(bool));
-}
-
-
-void Symbol::deserialize(std::istream& in) {
-	in.read((char*)& symbolTableEntry, sizeof(uint16_t));
-
-	size_t size;
-	in.read((char*)& size, sizeof(size_t));
-	char* temp = new char[size];
-	in.read(temp, size);
-	name.assign(temp, size);
-	delete[] temp;
-
-	in.read((char*)& size, sizeof(size_t));
-	temp = new char[size];
-	in.read(temp, size);
-	section.assign(temp, size);
-	delete[] temp;
-
-	in.read((char*)& value, sizeof(int16_t));
+void Symbol::format(std::string& out) const {
+	Utils::appendColumn(out, symbolTableEntry);
+	Utils::appendColumn(out, name);
+	Utils::appendColumn(out, section);
 
-	uint8_t enumType;
-	in.read((char*)& enumType, sizeof(uint8_t));
-	scope = static_cast<ScopeType>(enumType);
-	in.read((char*)& enumType, sizeof(uint8_t));
-	type = static_cast<SymbolType>(enumType);
+	if (section == UNDEFINED)
+		Utils::appendColumn(out, UNDEFINED);
+	else
+		Utils::appendColumn(out, value);
 
-	in.read((char*)& defined, sizeof(bool));
+	Utils::appendColumn(out, toString(scope));
+	Utils::appendColumn(out, toString(type));
 }
 
 
 std::ostream& operator<<(std::ostream& out, const Symbol& symbol) {
-	out << std::left
-		<< std::setw(WIDTH) << symbol.symbolTableEntry
-		<< std::setw(WIDTH) << symbol.name
-		<< std::setw(WIDTH) << symbol.section
-		<< std::setw(WIDTH) << (symbol.section == UNDEFINED ? UNDEFINED : std::to_string(symbol.value))
-		<< std::setw(WIDTH) << symbol.scope
-		<< std::setw(WIDTH) << symbol.type;
+	std::string row;
+	symbol.format(row);
 
-	return out;
+	return out << row;
 }
\ No newline at end of file
@@ -11,31 +11,32 @@ class Symbol {
 public:
 	Symbol();
 
+	// entry numbers are given by the owner of the symbol table, in order of creation
 	Symbol(const std::string& t_name,
+		   uint32_t t_entry,
 		   const std::string& t_section,
-		   int16_t t_value,
+		   int32_t t_value,
 		   ScopeType t_scope,
 		   SymbolType t_type,
 		   bool t_defined);
 
-	void setData(const std::string& section, int16_t value, ScopeType scope, SymbolType type, bool defined);
+	void setData(const std::string& section, int32_t value, ScopeType scope, SymbolType type, bool defined);
 
-	void serialize(std::ostream& out) const;
-
-	void deserialize(std::istream& in);
+	// appends a listing row (without line break) to the output buffer
+	void format(std::string& out) const;
 
 	friend class Loader;
+	friend class ObjectWriter;
+	friend class ImageWriter;
 	friend class Assembler;
 	friend std::ostream& operator<<(std::ostream& out, const Symbol& symbol);
 private:
-	static uint16_t lastSymbolTableEntry;
-
-	uint16_t symbolTableEntry;
+	uint32_t symbolTableEntry;
 
 	std::string name;
 
 	std::string section;
-	int16_t value;
+	int32_t value;
 
 	ScopeType scope;
 	SymbolType type;
@@ -1,60 +1,86 @@
+#include <regex>
 #include <iostream>
 
 #include "types.h"
 
 
-std::ostream& operator<<(std::ostream& out, ScopeType scopeType) {
+const std::regex objectFile("\\.o$");
+const std::regex assemblyFile("\\.s$");
+
+
+const char* toString(ScopeType scopeType) {
 	switch (scopeType) {
 	case GLOBAL:
-		return out << "Global";
+		return "Global";
 
 	case LOCAL:
-		return out << "Local";
+		return "Local";
 	}
+
+	return "";
 }
 
 
-std::ostream& operator<<(std::ostream& out, SymbolType symbolType) {
+std::ostream& operator<<(std::ostream& out, ScopeType scopeType) {
+	return out << toString(scopeType);
+}
+
+
+const char* toString(SymbolType symbolType) {
 	switch (symbolType) {
 	case SymbolType::LABEL:
-		return out << "Label";
+		return "Label";
 
 	case SymbolType::SECTION:
-		return out << "Section";
+		return "Section";
 
 	case SymbolType::CONSTANT:
-		return out << "Constant";
+		return "Constant";
 
 	case SymbolType::ALIAS:
-		return out << "Alias";
+		return "Alias";
 
 	case SymbolType::EXTERN:
-		return out << "Extern";
+		return "Extern";
 
 	case SymbolType::UNRESOLVED:
-		return out << "Unresolved";
+		return "Unresolved";
 	}
+
+	return "";
 }
 
 
-std::ostream& operator<<(std::ostream& out, RelocationType relocationType) {
+std::ostream& operator<<(std::ostream& out, SymbolType symbolType) {
+	return out << toString(symbolType);
+}
+
+
+const char* toString(RelocationType relocationType) {
 	switch (relocationType) {
 	case R_386_8:
-		return out << "R_386_8";
+		return "R_386_8";
 
 	case R_386_SUB_8:
-		return out << "R_386_SUB_8";
+		return "R_386_SUB_8";
 
 	case R_386_16:
-		return out << "R_386_16";
+		return "R_386_16";
 
 	case R_386_SUB_16:
-		return out << "R_386_SUB_16";
+		return "R_386_SUB_16";
 
 	case R_386_PC16:
-		return out << "R_386_PC16";
+		return "R_386_PC16";
 
 	case R_386_SUB_PC16:
-		return out << "R_386_SUB_PC16";
+		return "R_386_SUB_PC16";
 	}
+
+	return "";
+}
+
+
+std::ostream& operator<<(std::ostream& out, RelocationType relocationType) {
+	return out << toString(relocationType);
 }
\ No newline at end of file
@@ -16,11 +16,13 @@ constexpr uint8_t WIDTH = 15;
 constexpr auto UNDEFINED = "N/A";
 
 
-const std::regex objectFile("\\.o$");
-const std::regex assemblyFile("\\.s$");
+// defined once in types.cpp, every regex costs a compilation at startup
+extern const std::regex objectFile;
+extern const std::regex assemblyFile;
 
 
 enum ScopeType : uint8_t { GLOBAL, LOCAL };
+const char* toString(ScopeType scopeType);
 std::ostream& operator<<(std::ostream& out, ScopeType scopeType);
 
 
@@ -40,7 +42,6 @@ enum TokenType : uint8_t {
 	OPERAND_REGINDDISP,
 	OPERAND_IMMED,
 	OPERAND_MEMORY,
-	EXPRESSION,
 	INVALID
 };
 
@@ -60,6 +61,7 @@ enum class SymbolType : uint8_t {
 	EXTERN,
 	UNRESOLVED
 };
+const char* toString(SymbolType symbolType);
 std::ostream& operator<<(std::ostream& out, SymbolType symbolType);
 
 
@@ -109,9 +111,14 @@ enum RelocationType : uint8_t {
 	R_386_PC16,
 	R_386_SUB_PC16
 };
+const char* toString(RelocationType relocationType);
 std::ostream& operator<<(std::ostream& out, RelocationType relocationType);
 
 
+// relocatable object file, raw memory image or Intel HEX memory image
+enum OutputFormat : uint8_t { OBJECT, BINARY, IHEX };
+
+
 enum InterruptType : uint8_t {
 	INITIALIZATION,
 	INSTRUCTION_ERROR,
@@ -8,20 +8,34 @@
 
 #include "types.h"
 #include "section.h"
+#include "expression.h"
 
 class UnresolvedSymbol {
 public:
-	UnresolvedSymbol(const std::string& t_name, Section* t_section) : name(t_name), section(t_section) {}
+	UnresolvedSymbol(const std::string& t_name, Section* t_section, const Expression& t_expression,
+					 uint32_t t_line, uint32_t t_file, size_t t_order) :
+		name(t_name), section(t_section), expression(t_expression), line(t_line), file(t_file), order(t_order) {}
 
 	friend class Assembler;
 private:
 	std::string name;
 
+	// symbols of the expression until it is resolved, then the relocatable terms
 	// pair.first  -> symbol name
 	// pair.second -> type of operation ("+" or "-")
 	std::vector<std::pair<std::string, std::string>> dependencies;
 
 	Section* section;
+
+	// .equ expression, folded by Assembler::resolveSymbols once all labels are known
+	Expression expression;
+
+	// the .equ statement, for diagnostics
+	uint32_t line;
+	uint32_t file;
+
+	// number of the .equ among the aliases, in definition order
+	size_t order;
 };
 
 #endif
\ No newline at end of file
@@ -1,8 +1,14 @@
 #include <vector>
 #include <string>
 #include <utility>
+#include <algorithm>
 #include <regex>
 #include <sstream>
+#include <cstdio>
+#include <cstring>
+#include <cstdlib>
+#include <cctype>
+#include <cerrno>
 
 #include "types.h"
 #include "utils.h"
@@ -10,26 +16,25 @@
 using namespace std;
 
 
-pair<TokenType, regex> Utils::tokenMatcher[] = {
-	{ GLOBAL_EXTERN,		regex("^\\.(global|extern)$") },
-	{ LABEL,				regex("^([a-zA-Z_]\\w*):$") },
-	{ SECTION,				regex("^\\.(text|data|bss|section)$") },
-	{ SECTION_FLAGS,		regex("^\"([waxmsilgte]+)\"$") },
-	{ DIRECTIVE,			regex("^\\.(equ|byte|word|align|skip)$") },
-	{ INSTRUCTION,			regex("^(halt|int|jmp|jeq|jne|jgt|call|ret|iret)$") },
-	{ INSTRUCTION,			regex("^(xchg|mov|add|sub|mul|div|cmp|not|and|or|xor|test|shl|shr|push|pop)(b|w)?$") },
-	{ SYMBOL_IMMED,			regex("^&([a-zA-Z_]\\w*)$") },
-	{ SYMBOL_PCREL,			regex("^\\$([a-zA-Z_]\\w*)$") },
-	{ OPERAND_REG,			regex("^(pc|sp|psw|r[01234567])(h|l)?$") },
-	{ OPERAND_REGIND,		regex("^\\[(pc|sp|psw|r[01234567])\\]$") },
-	{ OPERAND_REGIND,		regex("^(pc|sp|psw|r[01234567])\\[0\\]$") },
-	{ OPERAND_REGINDDISP,	regex("^(pc|sp|psw|r[01234567])\\[([0-9]+|0x[0-9abcdefABCDEF]+|[a-zA-Z_]\\w*)\\]$") },
-	{ OPERAND_REGINDDISP,	regex("^\\[(pc|sp|psw|r[01234567])\\]([0-9]+|0x[0-9abcdefABCDEF]+|[a-zA-Z_]\\w*)$") },
-	{ OPERAND_IMMED,		regex("^(-?[0-9]+|0x[0-9abcdefABCDEF]+)$") },
-	{ OPERAND_MEMORY,		regex("^\\*([0-9]+|0x[0-9abcdefABCDEF]+)$") },
-	{ SYMBOL,				regex("^([a-zA-Z_]\\w*)$") },
-	{ SECTION_NAME,			regex("^(\\.?[a-zA-Z]\\w*)$") },
-	{ EXPRESSION,			regex("^(\\w+)([\\+-])(\\w+)$") }
+Utils::TokenMatcher Utils::tokenMatcher[] = {
+	{ GLOBAL_EXTERN,		DOT,			regex("^\\.(global|extern)$") },
+	{ LABEL,				LETTER,			regex("^([a-zA-Z_]\\w*):$") },
+	{ SECTION,				DOT,			regex("^\\.(text|data|bss|section)$") },
+	{ SECTION_FLAGS,		QUOTE,			regex("^\"([waxmsilgte]+)\"$") },
+	{ DIRECTIVE,			DOT,			regex("^\\.(equ|byte|word|align|skip|incbin)$") },
+	{ INSTRUCTION,			LETTER,			regex("^(halt|int|jmp|jeq|jne|jgt|call|ret|iret)$") },
+	{ INSTRUCTION,			LETTER,			regex("^(xchg|mov|add|sub|mul|div|cmp|not|and|or|xor|test|shl|shr|push|pop)(b|w)?$") },
+	{ SYMBOL_IMMED,			AMPERSAND,		regex("^&([a-zA-Z_]\\w*)$") },
+	{ SYMBOL_PCREL,			DOLLAR,			regex("^\\$([a-zA-Z_]\\w*)$") },
+	{ OPERAND_REG,			LETTER,			regex("^(pc|sp|psw|r[01234567])(h|l)?$") },
+	{ OPERAND_REGIND,		BRACKET,		regex("^\\[(pc|sp|psw|r[01234567])\\]$") },
+	{ OPERAND_REGIND,		LETTER,			regex("^(pc|sp|psw|r[01234567])\\[0\\]$") },
+	{ OPERAND_REGINDDISP,	LETTER,			regex("^(pc|sp|psw|r[01234567])\\[([0-9]+|0x[0-9abcdefABCDEF]+|[a-zA-Z_]\\w*)\\]$") },
+	{ OPERAND_REGINDDISP,	BRACKET,		regex("^\\[(pc|sp|psw|r[01234567])\\]([0-9]+|0x[0-9abcdefABCDEF]+|[a-zA-Z_]\\w*)$") },
+	{ OPERAND_IMMED,		DIGIT,			regex("^(-?[0-9]+|0x[0-9abcdefABCDEF]+)$") },
+	{ OPERAND_MEMORY,		STAR,			regex("^\\*([0-9]+|0x[0-9abcdefABCDEF]+)$") },
+	{ SYMBOL,				LETTER,			regex("^([a-zA-Z_]\\w*)$") },
+	{ SECTION_NAME,			DOT | LETTER,	regex("^(\\.?[a-zA-Z]\\w*)$") }
 };
 
 
@@ -46,16 +51,40 @@ void Utils::split(const string& s, const char* delimiter, vector<string>& tokens
 }
 
 
+uint8_t Utils::characterClass(char c) {
+	switch (c) {
+	case '.':	return DOT;
+	case '"':	return QUOTE;
+	case '&':	return AMPERSAND;
+	case '$':	return DOLLAR;
+	case '[':	return BRACKET;
+	case '*':	return STAR;
+	case '-':	return DIGIT;
+	case '_':	return LETTER;
+	}
+
+	if (isdigit((unsigned char)c)) return DIGIT;
+	if (isalpha((unsigned char)c)) return LETTER;
+
+	return 0;
+}
+
+
 TokenType Utils::getTokenType(const string& token, smatch& matches) {
 	TokenType result = INVALID;
 
+	uint8_t first = token.empty() ? 0 : characterClass(token[0]);
+
 	for (const auto& entry : tokenMatcher) {
-		if (regex_match(token, matches, entry.second)) {
-			result = entry.first;
+		if ((entry.first & first) && regex_match(token, matches, entry.expression)) {
+			result = entry.type;
 			break;
 		}
 	}
 
+	// as if every regex had failed
+	if (result == INVALID) matches = smatch();
+
 	return result;
 }
 
@@ -66,10 +95,24 @@ bool Utils::isJump(const std::string& mnemonic) {
 }
 
 
-bool Utils::isExpression(const std::string& token) {
-	return regex_match(token, tokenMatcher[14].second) ||
-		   regex_match(token, tokenMatcher[16].second) ||
-		   regex_match(token, tokenMatcher[18].second);
+bool Utils::parseLiteral(const string& token, int64_t& value) {
+	size_t i = 0;
+	bool hex = token.size() > 2 && token[0] == '0' && token[1] == 'x';
+
+	if (hex)
+		i = 2;
+	else if (!token.empty() && token[0] == '-')
+		i = 1;
+
+	if (i == token.size()) return false;
+
+	for (; i < token.size(); i++)
+		if (hex ? !isxdigit((unsigned char)token[i]) : !isdigit((unsigned char)token[i])) return false;
+
+	// out of range literals are left to the expression engine to report
+	errno = 0;
+	value = strtoll(token.c_str(), NULL, 0);
+	return errno != ERANGE;
 }
 
 
@@ -87,6 +130,26 @@ void Utils::setFlags(string& flags, const string& match) {
 }
 
 
+uint16_t Utils::getFlagMask(const string& flags) {
+	uint16_t mask = 0;
+
+	for (size_t i = 0; i < flags.size(); i++)
+		if (flags[i] == '1') mask |= 1 << i;
+
+	return mask;
+}
+
+
+string Utils::getFlags(uint16_t mask) {
+	string flags(10, '0');
+
+	for (size_t i = 0; i < flags.size(); i++)
+		if (mask & 1 << i) flags[i] = '1';
+
+	return flags;
+}
+
+
 string Utils::toHexString(int16_t number) {
 	stringstream stream;
 
@@ -94,4 +157,272 @@ string Utils::toHexString(int16_t number) {
 
 	stream << hex << number;
 	return string(stream.str());
+}
+
+
+void Utils::appendColumn(string& out, const string& value) {
+	out += value;
+
+	if (value.size() < WIDTH) out.append(WIDTH - value.size(), ' ');
+}
+
+
+void Utils::appendColumn(string& out, const char* value) {
+	size_t length = strlen(value);
+	out.append(value, length);
+
+	if (length < WIDTH) out.append(WIDTH - length, ' ');
+}
+
+
+void Utils::appendColumn(string& out, long long value) {
+	char buffer[24];
+	int length = snprintf(buffer, sizeof(buffer), "%lld", value);
+
+	out.append(buffer, length);
+
+	if (length < WIDTH) out.append(WIDTH - length, ' ');
+}
+
+
+void Utils::appendHex(string& out, uint8_t byte) {
+	static const char digits[] = "0123456789ABCDEF";
+
+	out += digits[byte >> 4];
+	out += digits[byte & 0xF];
+}
+
+
+void Utils::appendHexDump(string& out, const uint8_t* bytes, size_t size) {
+	const uint8_t bytesPerLine = 16;
+
+	out.reserve(out.size() + size * 3 + size / bytesPerLine + 1);
+
+	for (size_t i = 0; i < size; i++) {
+		if (i > 0 && i % bytesPerLine == 0) out += '\n';
+
+		appendHex(out, bytes[i]);
+		out += ' ';
+	}
+	out += '\n';
+}
+
+
+void Utils::appendULEB128(string& out, uint32_t value) {
+	do {
+		uint8_t byte = value & 0x7F;
+		value >>= 7;
+
+		if (value) byte |= 0x80;
+		out += (char)byte;
+	} while (value);
+}
+
+
+bool Utils::readULEB128(const uint8_t*& data, const uint8_t* end, uint32_t& value) {
+	value = 0;
+
+	for (uint8_t shift = 0; data < end && shift < 35; shift += 7) {
+		uint8_t byte = *data++;
+		value |= (uint32_t)(byte & 0x7F) << shift;
+
+		if (!(byte & 0x80)) return true;
+	}
+
+	return false;
+}
+
+
+void Utils::appendSLEB128(string& out, int32_t value) {
+	bool more = true;
+
+	while (more) {
+		uint8_t byte = value & 0x7F;
+		value >>= 7;
+
+		more = !((value == 0 && !(byte & 0x40)) || (value == -1 && (byte & 0x40)));
+
+		if (more) byte |= 0x80;
+		out += (char)byte;
+	}
+}
+
+
+bool Utils::readSLEB128(const uint8_t*& data, const uint8_t* end, int32_t& value) {
+	uint32_t result = 0;
+
+	for (uint8_t shift = 0; data < end && shift < 35; shift += 7) {
+		uint8_t byte = *data++;
+		result |= (uint32_t)(byte & 0x7F) << shift;
+
+		if (!(byte & 0x80)) {
+			if (shift + 7 < 32 && (byte & 0x40)) result |= ~0u << (shift + 7);
+
+			value = (int32_t)result;
+			return true;
+		}
+	}
+
+	return false;
+}
+
+
+uint32_t Utils::crc32(const uint8_t* data, size_t size, uint32_t crc) {
+	// built once, thread-safe as a local static
+	static const vector<uint32_t> table = []() {
+		vector<uint32_t> values(256);
+
+		for (uint32_t i = 0; i < 256; i++) {
+			uint32_t value = i;
+
+			for (int j = 0; j < 8; j++)
+				value = value & 1 ? 0xEDB88320 ^ value >> 1 : value >> 1;
+
+			values[i] = value;
+		}
+
+		return values;
+	}();
+
+	crc = ~crc;
+
+	for (size_t i = 0; i < size; i++)
+		crc = table[(crc ^ data[i]) & 0xFF] ^ crc >> 8;
+
+	return ~crc;
+}
+
+
+uint64_t Utils::hash64(const uint8_t* data, size_t size, uint64_t hash) {
+	for (size_t i = 0; i < size; i++)
+		hash = (hash ^ data[i]) * 0x100000001B3;
+
+	return hash;
+}
+
+
+// Compressed block is a sequence of
+//
+//   token | literal length... | literals | offset (16 bits) | match length...
+//
+// with the literal count in the high and match length - LZ_MIN_MATCH in the
+// low nibble of the token. A nibble of 15 continues with bytes added to it
+// until one is below 255. The last sequence has only literals.
+static const size_t LZ_MIN_MATCH = 4;
+static const size_t LZ_MAX_OFFSET = 0xFFFF;
+static const uint8_t LZ_HASH_BITS = 14;
+
+
+static void appendLength(string& out, size_t length) {
+	for (; length >= 255; length -= 255) out += (char)255;
+	out += (char)length;
+}
+
+
+static bool readLength(const uint8_t*& data, const uint8_t* end, size_t& length) {
+	uint8_t byte;
+
+	do {
+		if (data == end) return false;
+
+		byte = *data++;
+		length += byte;
+	} while (byte == 255);
+
+	return true;
+}
+
+
+static void appendSequence(string& out, const uint8_t* literals, size_t count, size_t offset, size_t match) {
+	size_t extra = match - LZ_MIN_MATCH;
+
+	out += (char)(min<size_t>(count, 15) << 4 | min<size_t>(extra, 15));
+	if (count >= 15) appendLength(out, count - 15);
+
+	out.append((const char*)literals, count);
+
+	out += (char)(offset & 0xFF);
+	out += (char)(offset >> 8);
+	if (extra >= 15) appendLength(out, extra - 15);
+}
+
+
+void Utils::compressLZ(const uint8_t* data, size_t size, string& out) {
+	// last position (+ 1) of each hashed 4 byte sequence, greedy matching
+	vector<uint32_t> positions(1 << LZ_HASH_BITS, 0);
+
+	size_t anchor = 0;
+	size_t position = 0;
+
+	while (position + LZ_MIN_MATCH <= size) {
+		uint32_t sequence;
+		memcpy(&sequence, data + position, sizeof(sequence));
+
+		uint32_t& slot = positions[sequence * 2654435761u >> (32 - LZ_HASH_BITS)];
+		size_t candidate = slot;
+		slot = position + 1;
+
+		if (candidate-- == 0 || position - candidate > LZ_MAX_OFFSET ||
+			memcmp(data + candidate, data + position, LZ_MIN_MATCH)) {
+			++position;
+			continue;
+		}
+
+		size_t match = LZ_MIN_MATCH;
+		while (position + match < size && data[candidate + match] == data[position + match]) ++match;
+
+		appendSequence(out, data + anchor, position - anchor, position - candidate, match);
+
+		position += match;
+		anchor = position;
+	}
+
+	size_t count = size - anchor;
+
+	out += (char)(min<size_t>(count, 15) << 4);
+	if (count >= 15) appendLength(out, count - 15);
+
+	out.append((const char*)data + anchor, count);
+}
+
+
+bool Utils::decompressLZ(const uint8_t* data, size_t length, uint8_t* out, size_t size) {
+	const uint8_t* end = data + length;
+	size_t position = 0;
+
+	while (data < end) {
+		uint8_t token = *data++;
+
+		size_t count = token >> 4;
+		if (count == 15 && !readLength(data, end, count)) return false;
+
+		if (count > (size_t)(end - data) || count > size - position) return false;
+
+		memcpy(out + position, data, count);
+		data += count;
+		position += count;
+
+		if (data == end) break;
+
+		if (end - data < 2) return false;
+
+		size_t offset = data[0] | data[1] << 8;
+		data += 2;
+
+		size_t match = token & 0x0F;
+		if (match == 15 && !readLength(data, end, match)) return false;
+		match += LZ_MIN_MATCH;
+
+		if (offset == 0 || offset > position || match > size - position) return false;
+
+		// overlapping matches repeat the last offset bytes
+		if (offset >= match)
+			memcpy(out + position, out + position - offset, match);
+		else
+			for (size_t i = 0; i < match; i++) out[position + i] = out[position + i - offset];
+
+		position += match;
+	}
+
+	return position == size;
 }
\ No newline at end of file
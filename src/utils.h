@@ -16,13 +16,63 @@ public:
 	static TokenType getTokenType(const std::string& token, std::smatch& matches);
 
 	static bool isJump(const std::string& mnemonic);
-	static bool isExpression(const std::string& token);
+
+	// integer literal (OPERAND_IMMED), parsed like strtoll with base 0; no regex involved
+	static bool parseLiteral(const std::string& token, int64_t& value);
 
 	static void setFlags(std::string& flags, const std::string& match);
 
+	// conversion between "WAXMSILGTE" flag string and bit mask
+	static uint16_t getFlagMask(const std::string& flags);
+	static std::string getFlags(uint16_t mask);
+
 	static std::string toHexString(int16_t number);
+
+	// listing helpers, append to the output buffer without going through iostream
+	static void appendColumn(std::string& out, const std::string& value);
+	static void appendColumn(std::string& out, const char* value);
+	static void appendColumn(std::string& out, long long value);
+
+	static void appendHex(std::string& out, uint8_t byte);
+
+	// "XX " per byte, 16 bytes per line
+	static void appendHexDump(std::string& out, const uint8_t* bytes, size_t size);
+
+	// unsigned LEB128 variable length integers
+	static void appendULEB128(std::string& out, uint32_t value);
+	static bool readULEB128(const uint8_t*& data, const uint8_t* end, uint32_t& value);
+
+	// signed LEB128 variable length integers
+	static void appendSLEB128(std::string& out, int32_t value);
+	static bool readSLEB128(const uint8_t*& data, const uint8_t* end, int32_t& value);
+
+	// CRC-32 (IEEE 802.3), can be continued by passing previous result
+	static uint32_t crc32(const uint8_t* data, size_t size, uint32_t crc = 0);
+
+	// FNV-1a (64 bit), can be continued by passing previous result
+	static uint64_t hash64(const uint8_t* data, size_t size, uint64_t hash = 0xCBF29CE484222325);
+
+	// LZ77 block compression (LZ4 style sequences), appends the compressed data
+	static void compressLZ(const uint8_t* data, size_t size, std::string& out);
+
+	// decompresses into exactly size bytes, false if data is malformed or of another size
+	static bool decompressLZ(const uint8_t* data, size_t length, uint8_t* out, size_t size);
 private:
-	static std::pair<TokenType, std::regex> tokenMatcher[];
+	// classes of the first character of a token
+	enum CharacterClass : uint8_t { DOT = 1, QUOTE = 2, AMPERSAND = 4, DOLLAR = 8, BRACKET = 16, STAR = 32, DIGIT = 64, LETTER = 128 };
+
+	static uint8_t characterClass(char c);
+
+	struct TokenMatcher {
+		TokenType type;
+
+		// classes a matching token can start with, the regex is only tried for those
+		uint8_t first;
+
+		std::regex expression;
+	};
+
+	static TokenMatcher tokenMatcher[];
 };
 
 #endif
\ No newline at end of file
@@ -15,4 +15,43 @@ bin/assembler -o tests/jumps.o tests/jumps.s
 echo setup.s
 bin/assembler -o tests/setup.o tests/setup.s
 echo loop.s
-bin/assembler -o tests/loop.o tests/loop.s
\ No newline at end of file
+bin/assembler -o tests/loop.o tests/loop.s
+echo image.s
+bin/assembler --format ihex --section-start ivt=0 --section-start text=0x100 -o tests/image.hex tests/image.s
+echo jumps.s -fpic
+bin/assembler -fpic -o tests/jumps_pic.o tests/jumps.s
+echo merge.s
+bin/assembler -o tests/merge.o tests/merge.s
+echo large.s
+bin/assembler -o tests/large.o tests/large.s
+echo tables.s --compress
+bin/assembler --compress -o tests/tables.o tests/tables.s
+
+echo incbin.s
+bin/assembler -o tests/incbin.o tests/incbin.s
+
+echo include.s
+bin/assembler -o tests/include.o tests/include.s
+
+echo macro.s
+bin/assembler -o tests/macro.o tests/macro.s
+
+echo setup.s --check
+bin/assembler --check tests/setup.s
+
+echo errors.s --check --max-errors 0
+bin/assembler --check --max-errors 0 tests/errors.s
+
+echo expressions.s
+bin/assembler -o tests/expressions.o tests/expressions.s
+
+echo macro.s --stream
+bin/assembler --stream -o tests/macro_stream.o tests/macro.s
+
+echo setup.s --threads 4
+bin/assembler --threads 4 -o tests/setup_threads.o tests/setup.s
+
+echo incbin.s -MD --if-changed
+rm -f tests/incbin_stamp.o
+bin/assembler -MD --if-changed -o tests/incbin_stamp.o tests/incbin.s
+bin/assembler -MD --if-changed -o tests/incbin_stamp.o tests/incbin.s
\ No newline at end of file
@@ -0,0 +1,30 @@
+# statements with errors, each is reported and the rest still assembled
+# (run with --check --max-errors 0)
+
+.section data, "a"
+first:
+.word 1, 2
+.byte 300
+.word first
+.section data2, "q"		# data stays open
+.word 3
+
+.section table, "am"
+.word 4464
+.word 70000			# same low bytes as above, not merged away
+.word 4294967297
+.byte 4294967297
+
+.section code, "ax"
+start:
+	mov r0, 1
+	mov r5, r1, r2
+	add r1
+	div r5, r2
+next:	xchg r1, 5
+	jmp next
+	push r0 r1
+	mov r0, 70000
+	mov r0, r1[70000]
+	halt
+.end
\ No newline at end of file
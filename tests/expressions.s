@@ -0,0 +1,24 @@
+# constant expressions, folded by the assembler or left to the linker as symbol +/- constant
+.global table, entries
+.extern base
+
+.section consts, "a"
+.equ	WIDTH, 40
+.equ	HEIGHT, 25
+.equ	CELLS, WIDTH * HEIGHT
+.equ	ROW_MASK, (1 << 5) - 1
+.equ	MODE, 0x80 | 0x03 & ~0x01
+.equ	entries, (table_end - table) / 2
+.equ	last, table_end - 2
+.equ	far, base + 0x10 - 4
+
+.word	CELLS, (-CELLS) % 7, ROW_MASK ^ 0xF, MODE >> 1
+.byte	HEIGHT + 1, (WIDTH - 1) * 2, ~0 & 0xFF
+.word	base - 1, far, last + 2 - table
+
+table:
+.word	1 + 2, 3 - 4 * 5, (3 - 4) * 5
+.word	table_end - table, entries
+table_end:
+
+.end
\ No newline at end of file
@@ -0,0 +1,35 @@
+# self-contained program for the memory image output:
+# assembler --format ihex --section-start ivt=0 --section-start text=0x100
+
+.section ivt, "a"
+.word reset
+.word fault
+.word reset
+.word reset
+
+.section text, "ax"
+reset:
+	mov sp, 0xFF00		# stack start
+	mov r0, &message
+	call $print			# pc relative call
+	halt
+
+fault:
+	halt
+
+print:
+	movb r1l, r0[0]
+	cmpb r1l, 0
+	jeq $done
+	movb *0xFF00, r1l
+	add r0, 1
+	jmp $print
+done:
+	ret
+
+.data
+message:
+	.byte 72, 105, 10, 0
+	.word message
+
+.end
\ No newline at end of file
@@ -0,0 +1,15 @@
+# binary files are embedded as they are, sized when the directive is read;
+# paths are relative to the source file
+
+.section font, "a"
+glyphs:	.incbin "glyphs.bin"		# A to D, 8 bytes each
+glyph_b:	.incbin "glyphs.bin", 8, 8	# B only
+tail:	.incbin "glyphs.bin", 24		# D, to the end of file
+end:
+.equ font_size, end - glyphs
+
+.text
+	movb r0l, r1[glyph_b]
+	halt
+
+.end
\ No newline at end of file
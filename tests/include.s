@@ -0,0 +1,13 @@
+# included files are read once per process and then reused while
+# unchanged; paths are relative to the including file
+
+.include "defs.inc"
+
+.text
+start:	mov r0, &greeting
+	mov r1, TIMER_PERIOD
+	call print
+	call wait
+	halt
+
+.end
\ No newline at end of file
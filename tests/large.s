@@ -0,0 +1,16 @@
+# sections may grow past 64 KB: offsets and sizes are 32-bit,
+# only 16-bit fields of the encoding are limited
+
+.section buffers, "w"
+first:	.skip 0x8000
+second:	.skip 0x8000
+third:	.skip 0x8000
+end:
+.equ total, end - first		# 98304, never encoded
+
+.section code, "ax"
+	mov r0, &first
+	mov r1, &second
+	halt
+
+.end
\ No newline at end of file
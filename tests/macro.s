@@ -0,0 +1,43 @@
+# macros and .rept blocks are expanded while the passes walk them, their
+# statements are stored once; \name is a macro argument, \@ the number of
+# the expansion (for labels local to it)
+
+.macro copy from, to, count
+	mov r0, \count
+copy\@:	movb r1l, r2[\from]
+	movb r2[\to], r1l
+	add r2, 1
+	sub r0, 1
+	jne $copy\@
+.endm
+
+.macro clear register
+	xor \register, \register
+.endm
+
+.text
+start:	clear r2
+	copy source, target, 4
+
+	.rept 4				# unrolled
+	add r3, 2
+	.endr
+
+	.rept 2
+	clear r4
+	.rept 3				# nested
+	add r4, r3
+	.endr
+	.endr
+
+	clear r2
+	copy source, target, 8
+	halt
+
+.data
+source:	.rept 8
+	.byte 0x55
+	.endr
+target:	.skip 8
+
+.end
\ No newline at end of file
@@ -0,0 +1,29 @@
+# identical entities of merge sections are kept once
+
+.section table, "am"
+first:	.word 1, 2, 3
+second:	.word 4, 5
+third:	.word 1, 2, 3		# differs from first by the byte below
+		.byte 7
+fourth:	.word 4, 5			# same as second
+fifth:	.word 4
+		.word 5				# same contents as second, other statements
+sixth:	.word first			# not literal, kept
+
+.section strings, "ams"
+hello:	.byte 72, 105, 0
+bye:	.byte 66, 121, 101, 0
+again:	.byte 72, 105, 0	# same as hello
+		.byte 66, 121, 101, 0
+		.skip 1
+
+.text
+_start:
+	mov r0, &third
+	mov r1, &fourth
+	mov r2, &fifth
+	mov r3, &again
+	mov r4, third
+	halt
+
+.end
\ No newline at end of file
@@ -0,0 +1,34 @@
+# lookup tables in a data section, stored LZ compressed with --compress;
+# code stays uncompressed so it can be disassembled in place
+
+.section tables, "aw"
+squares:
+	.word 0, 1, 4, 9, 16, 25, 36, 49
+	.word 64, 81, 100, 121, 144, 169, 196, 225
+	.word 256, 289, 324, 361, 400, 441, 484, 529
+	.word 576, 625, 676, 729, 784, 841, 900, 961
+	.word 1024, 1089, 1156, 1225, 1296, 1369, 1444, 1521
+	.word 1600, 1681, 1764, 1849, 1936, 2025, 2116, 2209
+	.word 2304, 2401, 2500, 2601, 2704, 2809, 2916, 3025
+	.word 3136, 3249, 3364, 3481, 3600, 3721, 3844, 3969
+font:
+	.byte 0x3C, 0x66, 0x66, 0x7E, 0x66, 0x66, 0x66, 0x00
+	.byte 0x7C, 0x66, 0x66, 0x7C, 0x66, 0x66, 0x7C, 0x00
+	.byte 0x3C, 0x66, 0x60, 0x60, 0x60, 0x66, 0x3C, 0x00
+	.byte 0x3C, 0x66, 0x66, 0x7E, 0x66, 0x66, 0x66, 0x00
+	.byte 0x7C, 0x66, 0x66, 0x7C, 0x66, 0x66, 0x7C, 0x00
+	.byte 0x3C, 0x66, 0x60, 0x60, 0x60, 0x66, 0x3C, 0x00
+	.byte 0x3C, 0x66, 0x66, 0x7E, 0x66, 0x66, 0x66, 0x00
+	.byte 0x7C, 0x66, 0x66, 0x7C, 0x66, 0x66, 0x7C, 0x00
+	.byte 0x3C, 0x66, 0x60, 0x60, 0x60, 0x66, 0x3C, 0x00
+	.byte 0x3C, 0x66, 0x66, 0x7E, 0x66, 0x66, 0x66, 0x00
+	.byte 0x7C, 0x66, 0x66, 0x7C, 0x66, 0x66, 0x7C, 0x00
+	.byte 0x3C, 0x66, 0x60, 0x60, 0x60, 0x66, 0x3C, 0x00
+blank:	.skip 64
+
+.text
+	mov r0, r1[squares]
+	movb r2l, r3[font]
+	halt
+
+.end
\ No newline at end of file
@@ -0,0 +1,308 @@
+// Prints the tables of object files in the same form as the assembler
+// listing and disassembles executable sections.
+//
+// Objects are mapped into memory and read in place, the output of each
+// file is built in one buffer and written at once.
+
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <utility>
+#include <algorithm>
+#include <exception>
+
+#include "exceptions.h"
+#include "types.h"
+#include "utils.h"
+#include "instruction.h"
+#include "object.h"
+
+using namespace std;
+
+static const char* usage = "Program should be called as: objdump [-d] object_file...\n\n";
+
+static const char* sectionName(const ObjectFile& object, uint32_t index) {
+	return index == NO_INDEX ? UNDEFINED : object.getString(object.section(index).name);
+}
+
+
+static void dumpTables(const ObjectFile& object, string& out) {
+	vector<uint8_t> contents;
+
+	for (const SectionEntry& section : object.sections()) {
+		if (littleEndian(section.stored) == 0) continue;
+
+		contents.resize(object.contentSize(section));
+		object.extract(section, contents.data());
+
+		out += "/*** Section \"";
+		out += object.getString(section.name);
+		out += "\" ***/\n\n";
+
+		Utils::appendHexDump(out, contents.data(), contents.size());
+		out += '\n';
+	}
+
+	out += "/*** Symbol Table ***/\n\n";
+	Utils::appendColumn(out, "Entry");
+	Utils::appendColumn(out, "Name");
+	Utils::appendColumn(out, "Section");
+	Utils::appendColumn(out, "Value");
+	Utils::appendColumn(out, "Scope");
+	Utils::appendColumn(out, "Type");
+	out += '\n';
+
+	uint32_t entry = 0;
+
+	for (const SymbolEntry& symbol : object.symbols()) {
+		uint32_t section = littleEndian(symbol.section);
+
+		Utils::appendColumn(out, entry++);
+		Utils::appendColumn(out, object.getString(symbol.name));
+		Utils::appendColumn(out, sectionName(object, section));
+
+		if (section == NO_INDEX)
+			Utils::appendColumn(out, UNDEFINED);
+		else
+			Utils::appendColumn(out, littleEndian(symbol.value));
+
+		Utils::appendColumn(out, toString((ScopeType)symbol.scope));
+		Utils::appendColumn(out, toString((SymbolType)symbol.type));
+		out += '\n';
+	}
+
+	out += '\n';
+	out += "/*** Section Table ***/\n\n";
+	Utils::appendColumn(out, "Entry");
+	Utils::appendColumn(out, "Name");
+	Utils::appendColumn(out, "Size");
+	Utils::appendColumn(out, "WAXMSILGTE");
+	Utils::appendColumn(out, "SymbolTableEntry");
+	out += '\n';
+
+	entry = 0;
+	bool relocations = false;
+
+	for (const SectionEntry& section : object.sections()) {
+		Utils::appendColumn(out, entry++);
+		Utils::appendColumn(out, object.getString(section.name));
+		Utils::appendColumn(out, littleEndian(section.size));
+		Utils::appendColumn(out, Utils::getFlags(littleEndian(section.flags)));
+		Utils::appendColumn(out, littleEndian(section.symbol));
+		out += '\n';
+
+		relocations |= section.relocationCount != 0;
+	}
+
+	if (relocations) {
+		out += '\n';
+		out += "/*** Relocation Table ***/\n\n";
+		Utils::appendColumn(out, "Symbol");
+		Utils::appendColumn(out, "Section");
+		Utils::appendColumn(out, "Offset");
+		Utils::appendColumn(out, "Type");
+		out += '\n';
+
+		for (const SectionEntry& section : object.sections()) {
+			for (const RelocationEntry& relocation : object.relocations(section)) {
+				Utils::appendColumn(out, object.getString(object.symbol(relocation.symbol).name));
+				Utils::appendColumn(out, object.getString(section.name));
+				Utils::appendColumn(out, relocation.offset);
+				Utils::appendColumn(out, toString(relocation.type));
+				out += '\n';
+			}
+		}
+	}
+
+	if (object.count(STAMP) > 0) {
+		out += '\n';
+		out += "/*** Stamp ***/\n\n";
+		Utils::appendColumn(out, "File");
+		Utils::appendColumn(out, "Hash");
+		out += '\n';
+
+		char hash[24];
+
+		for (const StampEntry& entry : object.stamp()) {
+			snprintf(hash, sizeof(hash), "%016llX", (unsigned long long)littleEndian(entry.hash));
+
+			Utils::appendColumn(out, littleEndian(entry.file) ? object.getString(entry.file) : "(options)");
+			Utils::appendColumn(out, hash);
+			out += '\n';
+		}
+	}
+
+	if (object.count(LINES) == 0) return;
+
+	out += '\n';
+	out += "/*** Line Table ***/\n\n";
+	Utils::appendColumn(out, "Section");
+	Utils::appendColumn(out, "Offset");
+	Utils::appendColumn(out, "Line");
+	out += "File\n";
+
+	for (const LineEntry& entry : object.lines()) {
+		Utils::appendColumn(out, sectionName(object, entry.section));
+		Utils::appendColumn(out, entry.offset);
+		Utils::appendColumn(out, entry.line);
+		out += object.getString(entry.file);
+		out += '\n';
+	}
+}
+
+
+static void disassemble(const ObjectFile& object, string& out) {
+	// sections are copied out of the mapped file with zeros past their end,
+	// so an instruction cut short never reads beyond the copy
+	vector<uint8_t> memory;
+
+	for (uint32_t index = 0; index < object.count(SECTIONS); index++) {
+		const SectionEntry& section = object.section(index);
+
+		size_t size = object.contentSize(section);
+
+		if (!(littleEndian(section.flags) & 1 << X) || size == 0) continue;
+
+		memory.assign(size + 8, 0);
+		object.extract(section, memory.data());
+
+		// labels of the section, ordered by address
+		vector<pair<int32_t, const char*>> labels;
+
+		for (const SymbolEntry& symbol : object.symbols())
+			if (littleEndian(symbol.section) == index && (SymbolType)symbol.type == SymbolType::LABEL)
+				labels.push_back({ littleEndian(symbol.value), object.getString(symbol.name) });
+
+		sort(labels.begin(), labels.end());
+
+		// source lines of the section, ordered by offset
+		vector<LineEntry> lines;
+
+		for (const LineEntry& entry : object.lines())
+			if (entry.section == index) lines.push_back(entry);
+
+		stable_sort(lines.begin(), lines.end(), [](const LineEntry& a, const LineEntry& b) {
+			return a.offset < b.offset;
+		});
+
+		out += "\n/*** Disassembly of section \"";
+		out += object.getString(section.name);
+		out += "\" ***/\n";
+
+		size_t label = 0;
+		size_t line = 0;
+		char address[24];
+
+		for (size_t PC = 0; PC < size;) {
+			for (; label < labels.size() && labels[label].first <= (int32_t)PC; label++) {
+				out += '\n';
+				out += labels[label].second;
+				out += ":\n";
+			}
+
+			for (; line < lines.size() && lines[line].offset <= PC; line++) {
+				if (line + 1 < lines.size() && lines[line + 1].offset <= PC) continue;
+
+				out += "        # ";
+				out += object.getString(lines[line].file);
+				out += ':';
+				out += to_string(lines[line].line);
+				out += '\n';
+			}
+
+			size_t length = BYTE;
+			string text;
+
+			try {
+				Instruction* instruction = Instruction::extract(memory.data(), PC);
+
+				length = instruction->getSize();
+				instruction->format(text);
+
+				delete instruction;
+			}
+			catch (const EmulatingException&) {
+				length = BYTE;
+				text = ".byte";
+			}
+
+			length = min(length, size - PC);
+
+			snprintf(address, sizeof(address), "%6zX:  ", PC);
+			out += address;
+
+			for (size_t i = 0; i < 7; i++) {
+				if (i < length)
+					Utils::appendHex(out, memory[PC + i]);
+				else
+					out += "  ";
+
+				out += ' ';
+			}
+
+			out += ' ';
+			out += text;
+			out += '\n';
+
+			PC += length;
+		}
+	}
+}
+
+
+int main(int argc, char* argv[]) {
+	bool disassembly = false;
+
+	vector<const char*> files;
+
+	for (int i = 1; i < argc; i++) {
+		if (!strcmp(argv[i], "-d"))
+			disassembly = true;
+		else if (argv[i][0] == '-') {
+			fprintf(stderr, "ERROR: Unrecognized option \"%s\"!\n", argv[i]);
+			fputs(usage, stdout);
+			return 1;
+		}
+		else
+			files.push_back(argv[i]);
+	}
+
+	if (files.empty()) {
+		fprintf(stderr, "ERROR: Wrong number of arguments!\n");
+		fputs(usage, stdout);
+		return 1;
+	}
+
+	int result = 0;
+	string out;
+
+	for (const char* file : files) {
+		out.clear();
+
+		try {
+			MappedObjectFile object(file);
+			object.validate();
+
+			if (files.size() > 1) {
+				out += file;
+				out += ":\n\n";
+			}
+
+			dumpTables(object, out);
+
+			if (disassembly) disassemble(object, out);
+
+			if (files.size() > 1) out += '\n';
+		}
+		catch (const exception& e) {
+			fprintf(stderr, "%s: %s\n\n", file, e.what());
+			result = 1;
+			continue;
+		}
+
+		fwrite(out.data(), 1, out.size(), stdout);
+	}
+
+	return result;
+}
\ No newline at end of file